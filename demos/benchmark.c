@@ -0,0 +1,843 @@
+#include <gral.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BENCHMARK_DURATION 2.0
+#define TEXT_RUN_COUNT 1000
+#define ICON_COUNT 1000
+
+struct demo_application {
+	struct gral_application *application;
+};
+
+struct demo_window {
+	struct gral_window *window;
+	struct gral_timer *timer;
+	struct gral_image *image;
+	void *image_data;
+	struct gral_image *video_image;
+	void *video_frame;
+	struct gral_font *font;
+	struct gral_text_run text_runs[TEXT_RUN_COUNT];
+	struct gral_path *icon;
+	struct gral_sprite sprites[ICON_COUNT];
+	struct gral_layer *layer;
+	struct gral_colored_rectangle *heatmap;
+	struct gral_point *series;
+	float *samples;
+	struct gral_sample_pyramid *sample_pyramid;
+	struct gral_path *marker;
+	struct gral_path_instance *scatter;
+	int scroll_position;
+	int document_position;
+	int document_steps;
+	int redraw_y;
+	int redraw_height;
+	int benchmark;
+	double operations;
+	double time;
+};
+
+struct benchmark {
+	char const *name;
+	char const *unit;
+	double (*run)(struct gral_draw_context *draw_context, struct demo_window *window);
+	void (*step)(struct demo_window *window);
+};
+
+static void *create_image_data(int width, int height) {
+	unsigned char *image_data = gral_memory_allocate(width * height * 4);
+	int x, y;
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			int i = (width * y + x) * 4;
+			image_data[i + 0] = x;
+			image_data[i + 1] = y;
+			image_data[i + 2] = x ^ y;
+			image_data[i + 3] = x + y;
+		}
+	}
+	return image_data;
+}
+
+static double run_draw_image(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < 50; i++) {
+		gral_draw_context_draw_image(draw_context, window->image, (i % 10) * 50.0f, (i / 10) * 50.0f);
+	}
+	return i;
+}
+
+static void keep_image_data(void *data, void *user_data) {
+
+}
+
+static double run_draw_image_converted(struct gral_draw_context *draw_context, struct demo_window *window) {
+	// the baseline for run_draw_image: images used to be converted from RGBA on every draw
+	int i;
+	for (i = 0; i < 50; i++) {
+		struct gral_image *image = gral_image_create_from_data(256, 256, 1024 * 4, GRAL_PIXEL_FORMAT_RGBA, window->image_data, &keep_image_data, NULL);
+		gral_draw_context_draw_image(draw_context, image, (i % 10) * 50.0f, (i / 10) * 50.0f);
+		gral_image_delete(image);
+	}
+	return i;
+}
+
+static double run_create_image(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < 10; i++) {
+		void *data = gral_memory_allocate(1024 * 1024 * 4);
+		memcpy(data, window->image_data, 1024 * 1024 * 4);
+		gral_image_delete(gral_image_create(1024, 1024, data));
+	}
+	return i * 1024 * 1024 / 1e6;
+}
+
+static double run_stream_create(struct gral_draw_context *draw_context, struct demo_window *window) {
+	void *data = gral_memory_allocate(3840 * 2160 * 4);
+	memcpy(data, window->video_frame, 3840 * 2160 * 4);
+	gral_image_delete(window->video_image);
+	window->video_image = gral_image_create(3840, 2160, data);
+	gral_draw_context_draw_image(draw_context, window->video_image, 0.0f, 0.0f);
+	return 1.0;
+}
+
+static double run_stream_update(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_image_update(window->video_image, 0, 0, 3840, 2160, window->video_frame);
+	gral_draw_context_draw_image(draw_context, window->video_image, 0.0f, 0.0f);
+	return 1.0;
+}
+
+static double draw_thumbnails(struct gral_draw_context *draw_context, struct demo_window *window, int filter) {
+	int i;
+	for (i = 0; i < 25; i++) {
+		gral_draw_context_draw_image_scaled(draw_context, window->video_image, 0.0f, 0.0f, 3840.0f, 2160.0f, (i % 5) * 160.0f, (i / 5) * 90.0f, 160.0f, 90.0f, filter);
+	}
+	return i;
+}
+
+static double run_draw_thumbnails(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_thumbnails(draw_context, window, GRAL_IMAGE_FILTER_LINEAR);
+}
+
+static double run_draw_thumbnails_smooth(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_thumbnails(draw_context, window, GRAL_IMAGE_FILTER_SMOOTH);
+}
+
+static double scroll_text(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < 40; i++) {
+		char line[64];
+		snprintf(line, sizeof(line), "%6d: the quick brown fox jumps over the lazy dog", (window->scroll_position + i) % 100000);
+		struct gral_text *text = gral_text_create(window->window, line, window->font);
+		gral_draw_context_draw_text(draw_context, text, 10.0f, 15.0f + i * 15.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		gral_text_delete(text);
+	}
+	window->scroll_position = (window->scroll_position + 1) % 100000;
+	return i;
+}
+
+static double run_scroll_text(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_text_cache_set_capacity(0);
+	return scroll_text(draw_context, window);
+}
+
+static double run_scroll_text_cached(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_text_cache_set_capacity(1000);
+	return scroll_text(draw_context, window);
+}
+
+#define LINE_HEIGHT 15
+
+static double run_scroll_document(struct gral_draw_context *draw_context, struct demo_window *window) {
+	// only draw the lines that intersect the redrawn area
+	gral_text_cache_set_capacity(1000);
+	int first_line = (window->document_position * LINE_HEIGHT + window->redraw_y) / LINE_HEIGHT;
+	int last_line = (window->document_position * LINE_HEIGHT + window->redraw_y + window->redraw_height) / LINE_HEIGHT;
+	int i;
+	for (i = first_line; i <= last_line; i++) {
+		float y = (i - window->document_position) * LINE_HEIGHT;
+		char line[64];
+		snprintf(line, sizeof(line), "%6d: the quick brown fox jumps over the lazy dog", i % 100000);
+		struct gral_text *text = gral_text_create(window->window, line, window->font);
+		struct gral_rectangle background = {0.0f, y, 800.0f, LINE_HEIGHT};
+		gral_draw_context_fill_rectangles(draw_context, &background, 1, 1.0f, 1.0f, 1.0f, 1.0f);
+		gral_draw_context_draw_text(draw_context, text, 10.0f, y + 12.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		gral_text_delete(text);
+	}
+	int steps = window->document_steps;
+	window->document_steps = 0;
+	return steps;
+}
+
+static void step_document_redraw(struct demo_window *window) {
+	window->document_position++;
+	window->document_steps++;
+	gral_window_request_redraw(window->window, 0, 0, 800, 600);
+}
+
+static void step_document_scroll(struct demo_window *window) {
+	window->document_position++;
+	window->document_steps++;
+	gral_window_scroll(window->window, 0, -LINE_HEIGHT, 0, 0, 800, 600);
+}
+
+#define TERMINAL_COLUMNS 200
+#define TERMINAL_ROWS 60
+
+static double draw_terminal(struct gral_draw_context *draw_context, struct demo_window *window, int use_attributes) {
+	int i;
+	for (i = 0; i < TERMINAL_ROWS; i++) {
+		char line[TERMINAL_COLUMNS + 1];
+		int j;
+		for (j = 0; j < TERMINAL_COLUMNS; j++) {
+			line[j] = 0x21 + (window->scroll_position + i * 7 + j) % 94;
+		}
+		line[TERMINAL_COLUMNS] = '\0';
+		struct gral_text *text = gral_text_create(window->window, line, window->font);
+		if (use_attributes) {
+			gral_text_set_color(text, 0, TERMINAL_COLUMNS, 0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		gral_draw_context_draw_text(draw_context, text, 0.0f, 10.0f + i * 10.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		gral_text_delete(text);
+	}
+	window->scroll_position = (window->scroll_position + 1) % 100000;
+	return i * TERMINAL_COLUMNS;
+}
+
+static double run_terminal(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_terminal(draw_context, window, 0);
+}
+
+static double run_terminal_attributes(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_terminal(draw_context, window, 1);
+}
+
+#define TOKEN_LENGTH 4
+#define TOKEN_COUNT (100 / TOKEN_LENGTH)
+
+static double draw_highlighted_lines(struct gral_draw_context *draw_context, struct demo_window *window, int use_spans) {
+	static float const colors[][3] = {
+		{0.6f, 0.0f, 0.6f},
+		{0.0f, 0.4f, 0.0f},
+		{0.0f, 0.0f, 0.8f},
+		{0.4f, 0.4f, 0.4f}
+	};
+	int i;
+	for (i = 0; i < 40; i++) {
+		char line[101];
+		int j;
+		for (j = 0; j < 100; j++) {
+			line[j] = 0x21 + (window->scroll_position + i * 7 + j) % 94;
+		}
+		line[100] = '\0';
+		struct gral_text *text = gral_text_create(window->window, line, window->font);
+		struct gral_text_span spans[TOKEN_COUNT];
+		for (j = 0; j < TOKEN_COUNT; j++) {
+			float const *color = colors[(i + j) % 4];
+			struct gral_text_span span = {j * TOKEN_LENGTH, (j + 1) * TOKEN_LENGTH, (i + j) % 3 == 0 ? GRAL_TEXT_STYLE_BOLD : 0, color[0], color[1], color[2], 1.0f};
+			spans[j] = span;
+		}
+		if (use_spans) {
+			gral_text_set_spans(text, spans, TOKEN_COUNT);
+		}
+		else {
+			for (j = 0; j < TOKEN_COUNT; j++) {
+				if (spans[j].style & GRAL_TEXT_STYLE_BOLD) {
+					gral_text_set_bold(text, spans[j].start_index, spans[j].end_index);
+				}
+				gral_text_set_color(text, spans[j].start_index, spans[j].end_index, spans[j].red, spans[j].green, spans[j].blue, spans[j].alpha);
+			}
+		}
+		gral_draw_context_draw_text(draw_context, text, 0.0f, 15.0f + i * 15.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		gral_text_delete(text);
+	}
+	window->scroll_position = (window->scroll_position + 1) % 100000;
+	return i;
+}
+
+static double run_highlight_lines(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_highlighted_lines(draw_context, window, 0);
+}
+
+static double run_highlight_lines_spans(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_highlighted_lines(draw_context, window, 1);
+}
+
+static double run_draw_text_runs(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < TEXT_RUN_COUNT; i++) {
+		struct gral_text_run const *run = &window->text_runs[i];
+		gral_draw_context_draw_text(draw_context, run->text, run->x, run->y, run->red, run->green, run->blue, run->alpha);
+	}
+	return i;
+}
+
+static double run_draw_text_batch(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_draw_text_batch(draw_context, window->text_runs, TEXT_RUN_COUNT);
+	return TEXT_RUN_COUNT;
+}
+
+static void create_text_runs(struct demo_window *window) {
+	static char const *const words[] = {"int", "return", "while", "struct", "x", "count", "0", "+="};
+	static float const colors[][3] = {{0.0f, 0.0f, 0.0f}, {0.5f, 0.0f, 0.5f}, {0.0f, 0.0f, 0.8f}, {0.0f, 0.5f, 0.0f}};
+	int i;
+	for (i = 0; i < TEXT_RUN_COUNT; i++) {
+		struct gral_text_run *run = &window->text_runs[i];
+		run->text = gral_text_create(window->window, words[i % 8], window->font);
+		run->x = 10.0f + (i % 25) * 31.0f;
+		run->y = 15.0f + (i / 25) * 14.0f;
+		run->red = colors[i % 4][0];
+		run->green = colors[i % 4][1];
+		run->blue = colors[i % 4][2];
+		run->alpha = 1.0f;
+	}
+}
+
+static float const icon_points[][2] = {
+	{8.0f, 0.0f}, {10.0f, 5.5f}, {16.0f, 6.0f}, {11.5f, 10.0f}, {13.0f, 16.0f},
+	{8.0f, 12.5f}, {3.0f, 16.0f}, {4.5f, 10.0f}, {0.0f, 6.0f}, {6.0f, 5.5f}
+};
+
+static void add_icon(struct gral_draw_context *draw_context, void *user_data) {
+	int i;
+	gral_draw_context_move_to(draw_context, icon_points[0][0], icon_points[0][1]);
+	for (i = 1; i < 10; i++) {
+		gral_draw_context_line_to(draw_context, icon_points[i][0], icon_points[i][1]);
+	}
+	gral_draw_context_close_path(draw_context);
+	gral_draw_context_fill(draw_context, 0.9f, 0.6f, 0.0f, 1.0f);
+}
+
+static void add_icon_path(struct gral_draw_context *draw_context, void *user_data) {
+	struct demo_window *window = user_data;
+	gral_draw_context_add_path(draw_context, window->icon);
+	gral_draw_context_fill(draw_context, 0.9f, 0.6f, 0.0f, 1.0f);
+}
+
+static struct gral_path *create_icon(void) {
+	struct gral_path *path = gral_path_create();
+	int i;
+	gral_path_move_to(path, icon_points[0][0], icon_points[0][1]);
+	for (i = 1; i < 10; i++) {
+		gral_path_line_to(path, icon_points[i][0], icon_points[i][1]);
+	}
+	gral_path_close_path(path);
+	return path;
+}
+
+static double draw_icons(struct gral_draw_context *draw_context, struct demo_window *window, void (*callback)(struct gral_draw_context *draw_context, void *user_data)) {
+	int i;
+	for (i = 0; i < ICON_COUNT; i++) {
+		gral_draw_context_draw_transformed(draw_context, 1.0f, 0.0f, 0.0f, 1.0f, (i % 40) * 20.0f, (i / 40) * 20.0f, callback, window);
+	}
+	return i;
+}
+
+static double run_draw_icons(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_icons(draw_context, window, &add_icon);
+}
+
+static double run_draw_icon_paths(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_icons(draw_context, window, &add_icon_path);
+}
+
+#define CANVAS_ICON_COUNT 100000
+#define CANVAS_COLUMNS 400
+
+static double draw_canvas(struct gral_draw_context *draw_context, struct demo_window *window, int check_visibility) {
+	int i;
+	for (i = 0; i < CANVAS_ICON_COUNT; i++) {
+		float x = (i % CANVAS_COLUMNS) * 20.0f;
+		float y = (i / CANVAS_COLUMNS) * 20.0f;
+		if (check_visibility && !gral_draw_context_is_rectangle_visible(draw_context, x, y, 16.0f, 16.0f)) {
+			continue;
+		}
+		gral_draw_context_draw_transformed(draw_context, 1.0f, 0.0f, 0.0f, 1.0f, x, y, &add_icon_path, window);
+	}
+	return i;
+}
+
+static double run_draw_canvas(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_canvas(draw_context, window, 0);
+}
+
+static double run_draw_canvas_culling(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_set_culling(draw_context, 1, 0.0f);
+	double icons = draw_canvas(draw_context, window, 0);
+	gral_draw_context_set_culling(draw_context, 0, 0.0f);
+	return icons;
+}
+
+static double run_draw_canvas_visibility(struct gral_draw_context *draw_context, struct demo_window *window) {
+	return draw_canvas(draw_context, window, 1);
+}
+
+static double run_draw_sprites_individually(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < ICON_COUNT; i++) {
+		struct gral_sprite const *sprite = &window->sprites[i];
+		gral_draw_context_draw_image_scaled(draw_context, window->image, sprite->source_x, sprite->source_y, sprite->width, sprite->height, sprite->x, sprite->y, sprite->width, sprite->height, GRAL_IMAGE_FILTER_NEAREST);
+	}
+	return i;
+}
+
+static double run_draw_sprites(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_draw_sprites(draw_context, window->image, window->sprites, ICON_COUNT, 0);
+	return ICON_COUNT;
+}
+
+static double run_draw_tinted_sprites(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_draw_sprites(draw_context, window->image, window->sprites, ICON_COUNT, 1);
+	return ICON_COUNT;
+}
+
+static void create_sprites(struct demo_window *window) {
+	// the 256x256 image is used as an atlas of 16x16 icons
+	int i;
+	for (i = 0; i < ICON_COUNT; i++) {
+		struct gral_sprite *sprite = &window->sprites[i];
+		sprite->source_x = (i % 16) * 16.0f;
+		sprite->source_y = (i / 16 % 16) * 16.0f;
+		sprite->width = 16.0f;
+		sprite->height = 16.0f;
+		sprite->x = (i % 40) * 20.0f;
+		sprite->y = (i / 40) * 20.0f;
+		sprite->red = 0.2f;
+		sprite->green = 0.4f;
+		sprite->blue = 0.8f;
+		sprite->alpha = 1.0f;
+	}
+}
+
+static double run_fill_gradients(struct gral_draw_context *draw_context, struct demo_window *window) {
+	static struct gral_gradient_stop const stops[] = {
+		{0.0f, 0.2f, 0.4f, 0.8f, 1.0f},
+		{0.5f, 0.9f, 0.9f, 0.9f, 1.0f},
+		{1.0f, 0.8f, 0.3f, 0.1f, 1.0f}
+	};
+	int i;
+	for (i = 0; i < 10000; i++) {
+		float x = (i % 100) * 8.0f;
+		float y = (i / 100) * 6.0f;
+		gral_draw_context_move_to(draw_context, x, y);
+		gral_draw_context_line_to(draw_context, x + 8.0f, y);
+		gral_draw_context_line_to(draw_context, x + 8.0f, y + 6.0f);
+		gral_draw_context_line_to(draw_context, x, y + 6.0f);
+		gral_draw_context_close_path(draw_context);
+		gral_draw_context_fill_linear_gradient(draw_context, 0.0f, 0.0f, 800.0f, 0.0f, stops, 3);
+	}
+	return i;
+}
+
+static void draw_grid(struct gral_draw_context *draw_context, void *user_data) {
+	int i;
+	for (i = 0; i <= 800; i += 10) {
+		gral_draw_context_move_to(draw_context, i, 0.0f);
+		gral_draw_context_line_to(draw_context, i, 600.0f);
+	}
+	for (i = 0; i <= 600; i += 10) {
+		gral_draw_context_move_to(draw_context, 0.0f, i);
+		gral_draw_context_line_to(draw_context, 800.0f, i);
+	}
+	gral_draw_context_stroke(draw_context, 1.0f, 0.8f, 0.8f, 0.8f, 1.0f);
+	for (i = 0; i < 2000; i++) {
+		gral_draw_context_move_to(draw_context, (i % 50) * 16.0f + 8.0f, (i / 50) * 15.0f + 2.0f);
+		gral_draw_context_line_to(draw_context, (i % 50) * 16.0f + 12.0f, (i / 50) * 15.0f + 10.0f);
+		gral_draw_context_line_to(draw_context, (i % 50) * 16.0f + 4.0f, (i / 50) * 15.0f + 10.0f);
+		gral_draw_context_close_path(draw_context);
+	}
+	gral_draw_context_fill(draw_context, 0.2f, 0.4f, 0.8f, 0.5f);
+}
+
+static double run_draw_grid(struct gral_draw_context *draw_context, struct demo_window *window) {
+	draw_grid(draw_context, window);
+	return 1.0;
+}
+
+static double run_draw_grid_layer(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_draw_layer(draw_context, window->layer, 0.0f, 0.0f, &draw_grid, window);
+	return 1.0;
+}
+
+#define HEATMAP_SIZE 1000
+
+static double run_draw_heatmap(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < HEATMAP_SIZE * HEATMAP_SIZE; i++) {
+		struct gral_colored_rectangle const *cell = &window->heatmap[i];
+		gral_draw_context_move_to(draw_context, cell->x, cell->y);
+		gral_draw_context_line_to(draw_context, cell->x + cell->width, cell->y);
+		gral_draw_context_line_to(draw_context, cell->x + cell->width, cell->y + cell->height);
+		gral_draw_context_line_to(draw_context, cell->x, cell->y + cell->height);
+		gral_draw_context_close_path(draw_context);
+		gral_draw_context_fill(draw_context, cell->red, cell->green, cell->blue, cell->alpha);
+	}
+	return i;
+}
+
+static double run_fill_heatmap(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_fill_colored_rectangles(draw_context, window->heatmap, HEATMAP_SIZE * HEATMAP_SIZE);
+	return HEATMAP_SIZE * HEATMAP_SIZE;
+}
+
+static struct gral_colored_rectangle *create_heatmap(void) {
+	struct gral_colored_rectangle *heatmap = gral_memory_allocate(HEATMAP_SIZE * HEATMAP_SIZE * sizeof(struct gral_colored_rectangle));
+	int i;
+	for (i = 0; i < HEATMAP_SIZE * HEATMAP_SIZE; i++) {
+		struct gral_colored_rectangle *cell = &heatmap[i];
+		float value = ((i % HEATMAP_SIZE) ^ (i / HEATMAP_SIZE)) % 256 / 255.0f;
+		cell->x = i % HEATMAP_SIZE;
+		cell->y = i / HEATMAP_SIZE;
+		cell->width = 1.0f;
+		cell->height = 1.0f;
+		cell->red = value;
+		cell->green = 0.2f;
+		cell->blue = 1.0f - value;
+		cell->alpha = 1.0f;
+	}
+	return heatmap;
+}
+
+#define SERIES_SIZE 100000
+
+static double run_stroke_series(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_move_to(draw_context, window->series[0].x, window->series[0].y);
+	int i;
+	for (i = 1; i < SERIES_SIZE; i++) {
+		gral_draw_context_line_to(draw_context, window->series[i].x, window->series[i].y);
+	}
+	gral_draw_context_stroke(draw_context, 1.0f, 0.2f, 0.6f, 1.0f, 1.0f);
+	return SERIES_SIZE;
+}
+
+static double run_stroke_series_polyline(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_add_polyline(draw_context, window->series, SERIES_SIZE, 0);
+	gral_draw_context_stroke(draw_context, 1.0f, 0.2f, 0.6f, 1.0f, 1.0f);
+	return SERIES_SIZE;
+}
+
+static struct gral_point *create_series(void) {
+	struct gral_point *series = gral_memory_allocate(SERIES_SIZE * sizeof(struct gral_point));
+	unsigned int random = 1;
+	float value = 300.0f;
+	int i;
+	for (i = 0; i < SERIES_SIZE; i++) {
+		random = random * 1103515245 + 12345;
+		value += (int)(random >> 16 & 0xFF) / 32.0f - 4.0f;
+		if (value < 0.0f) value = 0.0f;
+		if (value > 600.0f) value = 600.0f;
+		series[i].x = i * 800.0f / SERIES_SIZE;
+		series[i].y = value;
+	}
+	return series;
+}
+
+#define SAMPLE_COUNT 10000000
+
+static double run_stroke_samples(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_add_samples(draw_context, window->samples, SAMPLE_COUNT, NULL, 0.0f, 300.0f, 800.0f / SAMPLE_COUNT, 1.0f);
+	gral_draw_context_stroke(draw_context, 1.0f, 0.2f, 0.6f, 1.0f, 1.0f);
+	return SAMPLE_COUNT;
+}
+
+static double run_stroke_samples_pyramid(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_add_samples(draw_context, window->samples, SAMPLE_COUNT, window->sample_pyramid, 0.0f, 300.0f, 800.0f / SAMPLE_COUNT, 1.0f);
+	gral_draw_context_stroke(draw_context, 1.0f, 0.2f, 0.6f, 1.0f, 1.0f);
+	return SAMPLE_COUNT;
+}
+
+static float *create_samples(void) {
+	float *samples = gral_memory_allocate(SAMPLE_COUNT * sizeof(float));
+	unsigned int random = 1;
+	int i;
+	for (i = 0; i < SAMPLE_COUNT; i++) {
+		random = random * 1103515245 + 12345;
+		samples[i] = (int)(random >> 16 & 0xFF) - 128.0f;
+	}
+	return samples;
+}
+
+#define SCATTER_COUNT 100000
+#define MARKER_RADIUS 3.0f
+#define MARKER_CONTROL (MARKER_RADIUS * 0.5523f)
+
+static double run_draw_scatter(struct gral_draw_context *draw_context, struct demo_window *window) {
+	int i;
+	for (i = 0; i < SCATTER_COUNT; i++) {
+		struct gral_path_instance const *point = &window->scatter[i];
+		gral_draw_context_move_to(draw_context, point->x + MARKER_RADIUS, point->y);
+		gral_draw_context_curve_to(draw_context, point->x + MARKER_RADIUS, point->y + MARKER_CONTROL, point->x + MARKER_CONTROL, point->y + MARKER_RADIUS, point->x, point->y + MARKER_RADIUS);
+		gral_draw_context_curve_to(draw_context, point->x - MARKER_CONTROL, point->y + MARKER_RADIUS, point->x - MARKER_RADIUS, point->y + MARKER_CONTROL, point->x - MARKER_RADIUS, point->y);
+		gral_draw_context_curve_to(draw_context, point->x - MARKER_RADIUS, point->y - MARKER_CONTROL, point->x - MARKER_CONTROL, point->y - MARKER_RADIUS, point->x, point->y - MARKER_RADIUS);
+		gral_draw_context_curve_to(draw_context, point->x + MARKER_CONTROL, point->y - MARKER_RADIUS, point->x + MARKER_RADIUS, point->y - MARKER_CONTROL, point->x + MARKER_RADIUS, point->y);
+		gral_draw_context_close_path(draw_context);
+		gral_draw_context_fill(draw_context, point->red, point->green, point->blue, point->alpha);
+	}
+	return SCATTER_COUNT;
+}
+
+static double run_fill_scatter_instances(struct gral_draw_context *draw_context, struct demo_window *window) {
+	gral_draw_context_fill_path_instances(draw_context, window->marker, window->scatter, SCATTER_COUNT);
+	return SCATTER_COUNT;
+}
+
+static struct gral_path *create_marker(void) {
+	struct gral_path *marker = gral_path_create();
+	gral_path_move_to(marker, MARKER_RADIUS, 0.0f);
+	gral_path_curve_to(marker, MARKER_RADIUS, MARKER_CONTROL, MARKER_CONTROL, MARKER_RADIUS, 0.0f, MARKER_RADIUS);
+	gral_path_curve_to(marker, -MARKER_CONTROL, MARKER_RADIUS, -MARKER_RADIUS, MARKER_CONTROL, -MARKER_RADIUS, 0.0f);
+	gral_path_curve_to(marker, -MARKER_RADIUS, -MARKER_CONTROL, -MARKER_CONTROL, -MARKER_RADIUS, 0.0f, -MARKER_RADIUS);
+	gral_path_curve_to(marker, MARKER_CONTROL, -MARKER_RADIUS, MARKER_RADIUS, -MARKER_CONTROL, MARKER_RADIUS, 0.0f);
+	gral_path_close_path(marker);
+	return marker;
+}
+
+static struct gral_path_instance *create_scatter(void) {
+	struct gral_path_instance *scatter = gral_memory_allocate(SCATTER_COUNT * sizeof(struct gral_path_instance));
+	unsigned int random = 1;
+	int i;
+	for (i = 0; i < SCATTER_COUNT; i++) {
+		random = random * 1103515245 + 12345;
+		scatter[i].x = (random >> 8) % 80000 / 100.0f;
+		random = random * 1103515245 + 12345;
+		scatter[i].y = (random >> 8) % 60000 / 100.0f;
+		scatter[i].red = scatter[i].x / 800.0f;
+		scatter[i].green = 0.4f;
+		scatter[i].blue = scatter[i].y / 600.0f;
+		scatter[i].alpha = 0.8f;
+	}
+	return scatter;
+}
+
+static struct benchmark const benchmarks[] = {
+	{"draw image 256x256 converting it on every draw", "images", &run_draw_image_converted},
+	{"draw image 256x256", "images", &run_draw_image},
+	{"create image 1024x1024", "megapixels", &run_create_image},
+	{"stream 3840x2160 with gral_image_create", "frames", &run_stream_create},
+	{"stream 3840x2160 with gral_image_update", "frames", &run_stream_update},
+	{"draw 3840x2160 thumbnails with GRAL_IMAGE_FILTER_LINEAR", "thumbnails", &run_draw_thumbnails},
+	{"draw 3840x2160 thumbnails with GRAL_IMAGE_FILTER_SMOOTH", "thumbnails", &run_draw_thumbnails_smooth},
+	{"scroll 100k lines", "lines", &run_scroll_text},
+	{"scroll 100k lines with text cache", "lines", &run_scroll_text_cached},
+	{"scroll a document with gral_window_request_redraw", "steps", &run_scroll_document, &step_document_redraw},
+	{"scroll a document with gral_window_scroll", "steps", &run_scroll_document, &step_document_scroll},
+	{"terminal 200x60", "characters", &run_terminal},
+	{"terminal 200x60 with attributes", "characters", &run_terminal_attributes},
+	{"highlight 40 lines of 25 tokens with gral_text_set_color", "lines", &run_highlight_lines},
+	{"highlight 40 lines of 25 tokens with gral_text_set_spans", "lines", &run_highlight_lines_spans},
+	{"draw 1000 text runs individually", "runs", &run_draw_text_runs},
+	{"draw 1000 text runs with gral_draw_context_draw_text_batch", "runs", &run_draw_text_batch},
+	{"draw 1000 icons", "icons", &run_draw_icons},
+	{"draw 1000 icons with gral_path", "icons", &run_draw_icon_paths},
+	{"draw 100k icons on a large canvas", "icons", &run_draw_canvas},
+	{"draw 100k icons on a large canvas with gral_draw_context_set_culling", "icons", &run_draw_canvas_culling},
+	{"draw 100k icons on a large canvas with gral_draw_context_is_rectangle_visible", "icons", &run_draw_canvas_visibility},
+	{"draw 1000 sprites with gral_draw_context_draw_image_scaled", "sprites", &run_draw_sprites_individually},
+	{"draw 1000 sprites with gral_draw_context_draw_sprites", "sprites", &run_draw_sprites},
+	{"draw 1000 tinted sprites with gral_draw_context_draw_sprites", "sprites", &run_draw_tinted_sprites},
+	{"fill 10000 rectangles with a linear gradient", "fills", &run_fill_gradients},
+	{"draw a static background", "frames", &run_draw_grid},
+	{"draw a static background from a layer", "frames", &run_draw_grid_layer},
+	{"draw a 1000x1000 heatmap with paths", "cells", &run_draw_heatmap},
+	{"draw a 1000x1000 heatmap with gral_draw_context_fill_colored_rectangles", "cells", &run_fill_heatmap},
+	{"stroke a 100k point series with gral_draw_context_line_to", "points", &run_stroke_series},
+	{"stroke a 100k point series with gral_draw_context_add_polyline", "points", &run_stroke_series_polyline},
+	{"stroke 10M samples with gral_draw_context_add_samples", "samples", &run_stroke_samples},
+	{"stroke 10M samples with gral_draw_context_add_samples and a sample pyramid", "samples", &run_stroke_samples_pyramid},
+	{"draw a 100k point scatter plot with paths", "points", &run_draw_scatter},
+	{"draw a 100k point scatter plot with gral_draw_context_fill_path_instances", "points", &run_fill_scatter_instances}
+};
+
+#define BENCHMARK_COUNT (int)(sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+static void destroy(void *user_data) {
+	struct demo_window *window = user_data;
+	gral_timer_delete(window->timer);
+	gral_image_delete(window->image);
+	gral_memory_free(window->image_data);
+	gral_image_delete(window->video_image);
+	gral_memory_free(window->video_frame);
+	int i;
+	for (i = 0; i < TEXT_RUN_COUNT; i++) {
+		gral_text_delete(window->text_runs[i].text);
+	}
+	gral_font_delete(window->font);
+	gral_path_delete(window->icon);
+	gral_layer_delete(window->layer);
+	gral_memory_free(window->heatmap);
+	gral_memory_free(window->series);
+	gral_sample_pyramid_delete(window->sample_pyramid);
+	gral_memory_free(window->samples);
+	gral_path_delete(window->marker);
+	gral_memory_free(window->scatter);
+	gral_memory_free(window);
+}
+
+static int close(void *user_data) {
+	return 1;
+}
+
+static void draw(struct gral_draw_context *draw_context, int x, int y, int width, int height, void *user_data) {
+	struct demo_window *window = user_data;
+	if (window->benchmark >= BENCHMARK_COUNT) {
+		return;
+	}
+	struct benchmark const *benchmark = &benchmarks[window->benchmark];
+	window->redraw_y = y;
+	window->redraw_height = height;
+	double start = gral_time_get_monotonic();
+	window->operations += benchmark->run(draw_context, window);
+	window->time += gral_time_get_monotonic() - start;
+	if (window->time >= BENCHMARK_DURATION) {
+		printf("%s: %.1f %s/s\n", benchmark->name, window->operations / window->time, benchmark->unit);
+		window->benchmark++;
+		window->operations = 0.0;
+		window->time = 0.0;
+		gral_window_request_redraw(window->window, 0, 0, 800, 600);
+	}
+}
+
+static void resize(int width, int height, void *user_data) {
+
+}
+
+static void mouse_enter(void *user_data) {
+
+}
+
+static void mouse_leave(void *user_data) {
+
+}
+
+static void mouse_move(float x, float y, void *user_data) {
+
+}
+
+static void mouse_move_relative(float dx, float dy, void *user_data) {
+
+}
+
+static void mouse_button_press(float x, float y, int button, int modifiers, void *user_data) {
+
+}
+
+static void mouse_button_release(float x, float y, int button, void *user_data) {
+
+}
+
+static void double_click(float x, float y, int button, int modifiers, void *user_data) {
+
+}
+
+static void scroll(float dx, float dy, void *user_data) {
+
+}
+
+static void key_press(int key, int key_code, int modifiers, int is_repeat, void *user_data) {
+
+}
+
+static void key_release(int key, int key_code, void *user_data) {
+
+}
+
+static void text(char const *s, void *user_data) {
+
+}
+
+static void focus_enter(void *user_data) {
+
+}
+
+static void focus_leave(void *user_data) {
+
+}
+
+static void activate_menu_item(int id, void *user_data) {
+
+}
+
+static void timer(void *user_data) {
+	struct demo_window *window = user_data;
+	if (window->benchmark < BENCHMARK_COUNT && benchmarks[window->benchmark].step) {
+		benchmarks[window->benchmark].step(window);
+		return;
+	}
+	gral_window_request_redraw(window->window, 0, 0, 800, 600);
+}
+
+static void create_window(void *user_data) {
+	struct demo_application *application = user_data;
+	struct demo_window *window = gral_memory_allocate(sizeof(struct demo_window));
+	static struct gral_window_interface const window_interface = {
+		&destroy,
+		&close,
+		&draw,
+		&resize,
+		&mouse_enter,
+		&mouse_leave,
+		&mouse_move,
+		&mouse_move_relative,
+		&mouse_button_press,
+		&mouse_button_release,
+		&double_click,
+		&scroll,
+		&key_press,
+		&key_release,
+		&text,
+		&focus_enter,
+		&focus_leave,
+		&activate_menu_item
+	};
+	window->window = gral_window_create(application->application, 800, 600, "gral benchmark", &window_interface, window);
+	window->image = gral_image_create(256, 256, create_image_data(256, 256));
+	window->image_data = create_image_data(1024, 1024);
+	window->video_image = gral_image_create(3840, 2160, create_image_data(3840, 2160));
+	window->video_frame = create_image_data(3840, 2160);
+	window->font = gral_font_create_monospace(window->window, 12.0f);
+	create_text_runs(window);
+	window->icon = create_icon();
+	create_sprites(window);
+	window->layer = gral_layer_create(800, 600);
+	window->heatmap = create_heatmap();
+	window->series = create_series();
+	window->samples = create_samples();
+	window->sample_pyramid = gral_sample_pyramid_create(window->samples, SAMPLE_COUNT);
+	window->marker = create_marker();
+	window->scatter = create_scatter();
+	window->scroll_position = 0;
+	window->document_position = 0;
+	window->document_steps = 0;
+	window->benchmark = 0;
+	window->operations = 0.0;
+	window->time = 0.0;
+	window->timer = gral_timer_create(1, &timer, window);
+	gral_window_set_minimum_size(window->window, 800, 600);
+	gral_window_show(window->window);
+}
+
+static void start(void *user_data) {
+
+}
+
+static void open_empty(void *user_data) {
+	create_window(user_data);
+}
+
+static void open_file(char const *path, void *user_data) {
+	create_window(user_data);
+}
+
+static void quit(void *user_data) {
+
+}
+
+int main(int argc, char **argv) {
+	struct demo_application application;
+	static struct gral_application_interface const application_interface = {&start, &open_empty, &open_file, &quit};
+	application.application = gral_application_create("com.github.eyelash.libgral.demos.benchmark", &application_interface, &application);
+	int result = gral_application_run(application.application, argc, argv);
+	gral_application_delete(application.application);
+	return result;
+}
@@ -0,0 +1,69 @@
+#include <gral_convert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// converts every color value at every alpha value from straight RGBA and compares the result of each version against a premultiplication done here
+
+// not a multiple of the vector widths, so the scalar tails are checked as well
+#define WIDTH 259
+#define HEIGHT 256
+
+static unsigned char premultiply(unsigned char color, unsigned char alpha) {
+	unsigned int x = color * alpha + 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static int check(char const *name, ConvertRowFunction convert_row, unsigned char const *rgba, uint32_t const *expected) {
+	uint32_t *pixels = malloc(WIDTH * HEIGHT * 4);
+	int mismatches = 0;
+	int x, y;
+	for (y = 0; y < HEIGHT; y++) {
+		convert_row(rgba + WIDTH * y * 4, pixels + WIDTH * y, WIDTH);
+	}
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			int i = WIDTH * y + x;
+			if (pixels[i] != expected[i]) {
+				if (mismatches == 0) {
+					printf("%s: first mismatch at color %d, alpha %d: %08X instead of %08X\n", name, y, x & 0xFF, (unsigned int)pixels[i], (unsigned int)expected[i]);
+				}
+				mismatches++;
+			}
+		}
+	}
+	printf("%s conversion: %d mismatches\n", name, mismatches);
+	free(pixels);
+	return mismatches;
+}
+
+int main(int argc, char **argv) {
+	unsigned char *rgba = malloc(WIDTH * HEIGHT * 4);
+	uint32_t *expected = malloc(WIDTH * HEIGHT * 4);
+	int x, y;
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			int i = WIDTH * y + x;
+			unsigned char alpha = x;
+			rgba[i * 4 + 0] = y;
+			rgba[i * 4 + 1] = 255 - y;
+			rgba[i * 4 + 2] = y * 7;
+			rgba[i * 4 + 3] = alpha;
+			expected[i] = (uint32_t)alpha << 24 | (uint32_t)premultiply(rgba[i * 4 + 0], alpha) << 16 | (uint32_t)premultiply(rgba[i * 4 + 1], alpha) << 8 | premultiply(rgba[i * 4 + 2], alpha);
+		}
+	}
+	int mismatches = check("scalar", &convert_row_scalar, rgba, expected);
+#if defined(HAVE_CONVERT_ROW_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		mismatches += check("sse2", &convert_row_sse2, rgba, expected);
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		mismatches += check("avx2", &convert_row_avx2, rgba, expected);
+	}
+#elif defined(HAVE_CONVERT_ROW_NEON)
+	mismatches += check("neon", &convert_row_neon, rgba, expected);
+#endif
+	free(rgba);
+	free(expected);
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,42 @@
+#include <gral.h>
+#include "scene.h"
+#include <stdio.h>
+
+#define WIDTH 600
+#define HEIGHT 400
+#define FONT_SIZE 80.0f
+#define BENCHMARK_DURATION 2.0
+
+int main(int argc, char **argv) {
+	struct gral_draw_context *draw_context = gral_draw_context_create(WIDTH, HEIGHT);
+	struct scene scene;
+	struct gral_font *font = gral_font_create_default(NULL, FONT_SIZE);
+	scene.text = gral_text_create(NULL, "libgral", font);
+	gral_font_get_metrics(NULL, font, &scene.ascent, &scene.descent);
+	gral_font_delete(font);
+
+	int frames = 0;
+	double start = gral_time_get_monotonic();
+	double time;
+	do {
+		draw_scene(draw_context, &scene, WIDTH, HEIGHT);
+		frames++;
+		time = gral_time_get_monotonic() - start;
+	} while (time < BENCHMARK_DURATION);
+	printf("draw scene %dx%d: %.1f frames/s\n", WIDTH, HEIGHT, frames / time);
+
+	// print a checksum of the pixels so that rendering changes can be detected
+	unsigned char *pixels = gral_memory_allocate(WIDTH * HEIGHT * 4);
+	gral_draw_context_get_pixels(draw_context, pixels);
+	unsigned long checksum = 0;
+	int i;
+	for (i = 0; i < WIDTH * HEIGHT * 4; i++) {
+		checksum = checksum * 31 + pixels[i];
+	}
+	printf("checksum: %08lx\n", checksum & 0xFFFFFFFF);
+	gral_memory_free(pixels);
+
+	gral_text_delete(scene.text);
+	gral_draw_context_delete(draw_context);
+	return 0;
+}
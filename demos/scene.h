@@ -0,0 +1,15 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <gral.h>
+
+// the text and shapes that are drawn by both the draw and the headless demo
+struct scene {
+	struct gral_text *text;
+	float ascent;
+	float descent;
+};
+
+void draw_scene(struct gral_draw_context *draw_context, struct scene *scene, float width, float height);
+
+#endif
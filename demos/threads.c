@@ -0,0 +1,194 @@
+#include <gral.h>
+#include <stdio.h>
+
+#define WIDTH 1600
+#define HEIGHT 1000
+#define BENCHMARK_DURATION 2.0
+#define MAX_THREADS 16
+
+struct demo_application {
+	struct gral_application *application;
+};
+
+struct demo_window {
+	struct gral_window *window;
+	struct gral_timer *timer;
+	int threads;
+	double start_time;
+};
+
+static void destroy(void *user_data) {
+	struct demo_window *window = user_data;
+	gral_timer_delete(window->timer);
+	gral_memory_free(window);
+}
+
+static int close(void *user_data) {
+	return 1;
+}
+
+static void draw(struct gral_draw_context *draw_context, int x, int y, int width, int height, void *user_data) {
+	static struct gral_gradient_stop const stops[] = {
+		{0.0f, 0.1f, 0.2f, 0.4f, 1.0f},
+		{1.0f, 0.4f, 0.1f, 0.2f, 1.0f}
+	};
+	gral_draw_context_move_to(draw_context, 0.0f, 0.0f);
+	gral_draw_context_line_to(draw_context, WIDTH, 0.0f);
+	gral_draw_context_line_to(draw_context, WIDTH, HEIGHT);
+	gral_draw_context_line_to(draw_context, 0.0f, HEIGHT);
+	gral_draw_context_close_path(draw_context);
+	gral_draw_context_fill_linear_gradient(draw_context, 0.0f, 0.0f, WIDTH, HEIGHT, stops, 2);
+	int i;
+	for (i = 0; i < 4000; i++) {
+		float cx = (i % 80) * 20.0f + 10.0f;
+		float cy = (i / 80) * 20.0f + 10.0f;
+		gral_draw_context_move_to(draw_context, cx, cy - 9.0f);
+		gral_draw_context_curve_to(draw_context, cx + 12.0f, cy - 9.0f, cx + 12.0f, cy + 9.0f, cx, cy + 9.0f);
+		gral_draw_context_curve_to(draw_context, cx - 12.0f, cy + 9.0f, cx - 12.0f, cy - 9.0f, cx, cy - 9.0f);
+		gral_draw_context_close_path(draw_context);
+	}
+	gral_draw_context_fill(draw_context, 0.9f, 0.8f, 0.2f, 0.6f);
+	for (i = 0; i < 80; i++) {
+		gral_draw_context_move_to(draw_context, i * 20.0f, 0.0f);
+		gral_draw_context_line_to(draw_context, WIDTH - i * 20.0f, HEIGHT);
+	}
+	gral_draw_context_stroke(draw_context, 1.5f, 1.0f, 1.0f, 1.0f, 0.5f);
+}
+
+static void resize(int width, int height, void *user_data) {
+
+}
+
+static void mouse_enter(void *user_data) {
+
+}
+
+static void mouse_leave(void *user_data) {
+
+}
+
+static void mouse_move(float x, float y, void *user_data) {
+
+}
+
+static void mouse_move_relative(float dx, float dy, void *user_data) {
+
+}
+
+static void mouse_button_press(float x, float y, int button, int modifiers, void *user_data) {
+
+}
+
+static void mouse_button_release(float x, float y, int button, void *user_data) {
+
+}
+
+static void double_click(float x, float y, int button, int modifiers, void *user_data) {
+
+}
+
+static void scroll(float dx, float dy, void *user_data) {
+
+}
+
+static void key_press(int key, int key_code, int modifiers, int is_repeat, void *user_data) {
+
+}
+
+static void key_release(int key, int key_code, void *user_data) {
+
+}
+
+static void text(char const *s, void *user_data) {
+
+}
+
+static void focus_enter(void *user_data) {
+
+}
+
+static void focus_leave(void *user_data) {
+
+}
+
+static void activate_menu_item(int id, void *user_data) {
+
+}
+
+static void timer(void *user_data) {
+	struct demo_window *window = user_data;
+	if (window->threads > MAX_THREADS) {
+		return;
+	}
+	double time = gral_time_get_monotonic();
+	if (time - window->start_time >= BENCHMARK_DURATION) {
+		struct gral_draw_statistics statistics;
+		gral_draw_statistics_get(&statistics);
+		if (statistics.frames > 0) {
+			printf("%d threads: %.1f frames/s\n", window->threads, statistics.frames / statistics.draw_time);
+		}
+		window->threads *= 2;
+		gral_window_set_render_threads(window->window, window->threads);
+		gral_draw_statistics_reset();
+		window->start_time = time;
+	}
+	gral_window_request_redraw(window->window, 0, 0, WIDTH, HEIGHT);
+}
+
+static void create_window(void *user_data) {
+	struct demo_application *application = user_data;
+	struct demo_window *window = gral_memory_allocate(sizeof(struct demo_window));
+	static struct gral_window_interface const window_interface = {
+		&destroy,
+		&close,
+		&draw,
+		&resize,
+		&mouse_enter,
+		&mouse_leave,
+		&mouse_move,
+		&mouse_move_relative,
+		&mouse_button_press,
+		&mouse_button_release,
+		&double_click,
+		&scroll,
+		&key_press,
+		&key_release,
+		&text,
+		&focus_enter,
+		&focus_leave,
+		&activate_menu_item
+	};
+	window->window = gral_window_create(application->application, WIDTH, HEIGHT, "gral threads benchmark", &window_interface, window);
+	window->threads = 1;
+	window->start_time = gral_time_get_monotonic();
+	gral_window_set_render_threads(window->window, window->threads);
+	gral_draw_statistics_reset();
+	window->timer = gral_timer_create(1, &timer, window);
+	gral_window_set_minimum_size(window->window, WIDTH, HEIGHT);
+	gral_window_show(window->window);
+}
+
+static void start(void *user_data) {
+
+}
+
+static void open_empty(void *user_data) {
+	create_window(user_data);
+}
+
+static void open_file(char const *path, void *user_data) {
+	create_window(user_data);
+}
+
+static void quit(void *user_data) {
+
+}
+
+int main(int argc, char **argv) {
+	struct demo_application application;
+	static struct gral_application_interface const application_interface = {&start, &open_empty, &open_file, &quit};
+	application.application = gral_application_create("com.github.eyelash.libgral.demos.threads", &application_interface, &application);
+	int result = gral_application_run(application.application, argc, argv);
+	gral_application_delete(application.application);
+	return result;
+}
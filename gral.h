@@ -52,6 +52,19 @@ enum {
 	GRAL_CURSOR_VERTICAL_ARROWS = 5,
 	GRAL_CURSOR_NONE = 0
 };
+enum {
+	GRAL_PIXEL_FORMAT_RGBA,
+	GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA
+};
+enum {
+	GRAL_IMAGE_FILTER_NEAREST,
+	GRAL_IMAGE_FILTER_LINEAR,
+	GRAL_IMAGE_FILTER_SMOOTH
+};
+enum {
+	GRAL_TEXT_STYLE_BOLD = 1 << 0,
+	GRAL_TEXT_STYLE_ITALIC = 1 << 1
+};
 enum {
 	GRAL_FILE_TYPE_REGULAR,
 	GRAL_FILE_TYPE_DIRECTORY,
@@ -68,6 +81,9 @@ struct gral_application_interface {
 struct gral_image;
 struct gral_font;
 struct gral_text;
+struct gral_path;
+struct gral_sample_pyramid;
+struct gral_layer;
 struct gral_gradient_stop {
 	float position;
 	float red;
@@ -76,6 +92,75 @@ struct gral_gradient_stop {
 	float alpha;
 };
 struct gral_draw_context;
+struct gral_point {
+	float x;
+	float y;
+};
+struct gral_rectangle {
+	float x;
+	float y;
+	float width;
+	float height;
+};
+struct gral_colored_rectangle {
+	float x;
+	float y;
+	float width;
+	float height;
+	float red;
+	float green;
+	float blue;
+	float alpha;
+};
+struct gral_path_instance {
+	float x;
+	float y;
+	float red;
+	float green;
+	float blue;
+	float alpha;
+};
+struct gral_sprite {
+	float source_x;
+	float source_y;
+	float width;
+	float height;
+	float x;
+	float y;
+	float red;
+	float green;
+	float blue;
+	float alpha;
+};
+struct gral_text_span {
+	int start_index;
+	int end_index;
+	int style;
+	float red;
+	float green;
+	float blue;
+	float alpha;
+};
+struct gral_text_run {
+	struct gral_text *text;
+	float x;
+	float y;
+	float red;
+	float green;
+	float blue;
+	float alpha;
+};
+struct gral_draw_statistics {
+	size_t frames;
+	size_t paths;
+	size_t fills;
+	size_t strokes;
+	size_t text_runs;
+	size_t images;
+	size_t converted_bytes;
+	double draw_time;
+	double flush_time;
+};
 struct gral_window;
 struct gral_window_interface {
 	void (*destroy)(void *user_data);
@@ -124,7 +209,9 @@ int gral_application_run(struct gral_application *application, int argc, char **
  ============*/
 
 struct gral_image *gral_image_create(int width, int height, void *data);
+struct gral_image *gral_image_create_from_data(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data);
 void gral_image_delete(struct gral_image *image);
+void gral_image_update(struct gral_image *image, int x, int y, int width, int height, void const *data);
 
 struct gral_font *gral_font_create(struct gral_window *window, char const *name, float size);
 struct gral_font *gral_font_create_default(struct gral_window *window, float size);
@@ -136,23 +223,56 @@ void gral_text_delete(struct gral_text *text);
 void gral_text_set_bold(struct gral_text *text, int start_index, int end_index);
 void gral_text_set_italic(struct gral_text *text, int start_index, int end_index);
 void gral_text_set_color(struct gral_text *text, int start_index, int end_index, float red, float green, float blue, float alpha);
+void gral_text_set_spans(struct gral_text *text, struct gral_text_span const *spans, int count);
 float gral_text_get_width(struct gral_text *text);
 float gral_text_index_to_x(struct gral_text *text, int index);
 int gral_text_x_to_index(struct gral_text *text, float x);
-
+void gral_text_cache_set_capacity(int capacity);
+void gral_text_cache_get_statistics(size_t *hits, size_t *misses);
+
+struct gral_path *gral_path_create(void);
+void gral_path_delete(struct gral_path *path);
+void gral_path_close_path(struct gral_path *path);
+void gral_path_move_to(struct gral_path *path, float x, float y);
+void gral_path_line_to(struct gral_path *path, float x, float y);
+void gral_path_curve_to(struct gral_path *path, float x1, float y1, float x2, float y2, float x, float y);
+struct gral_sample_pyramid *gral_sample_pyramid_create(float const *samples, int count);
+void gral_sample_pyramid_delete(struct gral_sample_pyramid *pyramid);
+struct gral_layer *gral_layer_create(int width, int height);
+void gral_layer_delete(struct gral_layer *layer);
+void gral_layer_invalidate(struct gral_layer *layer);
+
+struct gral_draw_context *gral_draw_context_create(int width, int height);
+void gral_draw_context_delete(struct gral_draw_context *draw_context);
+void gral_draw_context_get_pixels(struct gral_draw_context *draw_context, void *data);
 void gral_draw_context_draw_image(struct gral_draw_context *draw_context, struct gral_image *image, float x, float y);
+void gral_draw_context_draw_image_scaled(struct gral_draw_context *draw_context, struct gral_image *image, float source_x, float source_y, float source_width, float source_height, float x, float y, float width, float height, int filter);
+void gral_draw_context_draw_sprites(struct gral_draw_context *draw_context, struct gral_image *image, struct gral_sprite const *sprites, int count, int tinted);
+void gral_draw_context_draw_layer(struct gral_draw_context *draw_context, struct gral_layer *layer, float x, float y, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data);
 void gral_draw_context_draw_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y, float red, float green, float blue, float alpha);
+void gral_draw_context_draw_text_batch(struct gral_draw_context *draw_context, struct gral_text_run const *runs, int count);
 void gral_draw_context_add_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y);
+void gral_draw_context_add_path(struct gral_draw_context *draw_context, struct gral_path *path);
 void gral_draw_context_close_path(struct gral_draw_context *draw_context);
 void gral_draw_context_move_to(struct gral_draw_context *draw_context, float x, float y);
 void gral_draw_context_line_to(struct gral_draw_context *draw_context, float x, float y);
 void gral_draw_context_curve_to(struct gral_draw_context *draw_context, float x1, float y1, float x2, float y2, float x, float y);
+void gral_draw_context_add_polyline(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed);
+void gral_draw_context_add_curves(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed);
+void gral_draw_context_add_samples(struct gral_draw_context *draw_context, float const *samples, int count, struct gral_sample_pyramid *pyramid, float x, float y, float x_scale, float y_scale);
 void gral_draw_context_fill(struct gral_draw_context *draw_context, float red, float green, float blue, float alpha);
+void gral_draw_context_fill_rectangles(struct gral_draw_context *draw_context, struct gral_rectangle const *rectangles, int count, float red, float green, float blue, float alpha);
+void gral_draw_context_fill_colored_rectangles(struct gral_draw_context *draw_context, struct gral_colored_rectangle const *rectangles, int count);
+void gral_draw_context_fill_path_instances(struct gral_draw_context *draw_context, struct gral_path *path, struct gral_path_instance const *instances, int count);
 void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count);
 void gral_draw_context_stroke(struct gral_draw_context *draw_context, float line_width, float red, float green, float blue, float alpha);
 void gral_draw_context_stroke_linear_gradient(struct gral_draw_context *draw_context, float line_width, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count);
 void gral_draw_context_draw_clipped(struct gral_draw_context *draw_context, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data);
 void gral_draw_context_draw_transformed(struct gral_draw_context *draw_context, float a, float b, float c, float d, float e, float f, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data);
+int gral_draw_context_is_rectangle_visible(struct gral_draw_context *draw_context, float x, float y, float width, float height);
+void gral_draw_context_set_culling(struct gral_draw_context *draw_context, int enabled, float margin);
+void gral_draw_statistics_get(struct gral_draw_statistics *statistics);
+void gral_draw_statistics_reset(void);
 
 
 /*===========
@@ -163,7 +283,12 @@ struct gral_window *gral_window_create(struct gral_application *application, int
 void gral_window_show(struct gral_window *window);
 void gral_window_set_title(struct gral_window *window, char const *title);
 void gral_window_request_redraw(struct gral_window *window, int x, int y, int width, int height);
+// on Linux the first scroll makes the window keep a backing surface so that only the exposed strip has to be drawn, the other platforms redraw the whole rectangle
+void gral_window_scroll(struct gral_window *window, int dx, int dy, int x, int y, int width, int height);
 void gral_window_set_minimum_size(struct gral_window *window, int minimum_width, int minimum_height);
+void gral_window_set_redraw_merge_threshold(struct gral_window *window, int threshold);
+void gral_window_set_render_threads(struct gral_window *window, int threads);
+void gral_window_request_frame(struct gral_window *window, void (*callback)(double presentation_time, double frame_interval, void *user_data), void *user_data);
 void gral_window_set_cursor(struct gral_window *window, int cursor);
 void gral_window_hide_cursor(struct gral_window *window);
 void gral_window_show_cursor(struct gral_window *window);
@@ -0,0 +1,115 @@
+/*
+
+Copyright (c) 2016-2026 Elias Aebi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+// converts rows of straight RGBA to premultiplied native-endian ARGB32 for the Linux backend
+// the versions live in this internal header so that demos/convert.c can check each of them against the scalar one
+
+#ifndef GRAL_CONVERT_H
+#define GRAL_CONVERT_H
+
+#include <stdint.h>
+
+typedef void (*ConvertRowFunction)(unsigned char const *source, uint32_t *destination, int width);
+
+static void convert_row_scalar(unsigned char const *source, uint32_t *destination, int width) {
+	for (int x = 0; x < width; x++) {
+		uint32_t a = source[3];
+		uint32_t r = source[0] * a + 128;
+		uint32_t g = source[1] * a + 128;
+		uint32_t b = source[2] * a + 128;
+		r = (r + (r >> 8)) >> 8;
+		g = (g + (g >> 8)) >> 8;
+		b = (b + (b >> 8)) >> 8;
+		destination[x] = a << 24 | r << 16 | g << 8 | b;
+		source += 4;
+	}
+}
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CONVERT_ROW_X86
+#include <immintrin.h>
+__attribute__((target("sse2"))) static void convert_row_sse2(unsigned char const *source, uint32_t *destination, int width) {
+	__m128i const zero = _mm_setzero_si128();
+	__m128i const alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	__m128i const alpha_max = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+	__m128i const bias = _mm_set1_epi16(128);
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = _mm_loadu_si128((__m128i const *)(source + x * 4));
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+		// RGBA -> BGRA
+		low = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		high = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		// multiply the color channels by alpha and alpha by 255
+		__m128i low_alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m128i high_alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		low = _mm_add_epi16(_mm_mullo_epi16(low, _mm_or_si128(_mm_andnot_si128(alpha_mask, low_alpha), alpha_max)), bias);
+		high = _mm_add_epi16(_mm_mullo_epi16(high, _mm_or_si128(_mm_andnot_si128(alpha_mask, high_alpha), alpha_max)), bias);
+		// divide by 255
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+		_mm_storeu_si128((__m128i *)(destination + x), _mm_packus_epi16(low, high));
+	}
+	convert_row_scalar(source + x * 4, destination + x, width - x);
+}
+__attribute__((target("avx2"))) static void convert_row_avx2(unsigned char const *source, uint32_t *destination, int width) {
+	__m256i const zero = _mm256_setzero_si256();
+	__m256i const alpha_mask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+	__m256i const alpha_max = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+	__m256i const bias = _mm256_set1_epi16(128);
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i pixels = _mm256_loadu_si256((__m256i const *)(source + x * 4));
+		__m256i low = _mm256_unpacklo_epi8(pixels, zero);
+		__m256i high = _mm256_unpackhi_epi8(pixels, zero);
+		// RGBA -> BGRA
+		low = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(low, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		high = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(high, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+		// multiply the color channels by alpha and alpha by 255
+		__m256i low_alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(low, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		__m256i high_alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(high, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		low = _mm256_add_epi16(_mm256_mullo_epi16(low, _mm256_or_si256(_mm256_andnot_si256(alpha_mask, low_alpha), alpha_max)), bias);
+		high = _mm256_add_epi16(_mm256_mullo_epi16(high, _mm256_or_si256(_mm256_andnot_si256(alpha_mask, high_alpha), alpha_max)), bias);
+		// divide by 255
+		low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+		high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+		// unpack and pack operate within 128-bit lanes, so the pixel order is preserved
+		_mm256_storeu_si256((__m256i *)(destination + x), _mm256_packus_epi16(low, high));
+	}
+	convert_row_sse2(source + x * 4, destination + x, width - x);
+}
+#endif
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && (defined(__aarch64__) || defined(__ARM_NEON))
+#define HAVE_CONVERT_ROW_NEON
+#include <arm_neon.h>
+static uint8x16_t premultiply_neon(uint8x16_t color, uint8x16_t alpha) {
+	uint16x8_t low = vmull_u8(vget_low_u8(color), vget_low_u8(alpha));
+	uint16x8_t high = vmull_u8(vget_high_u8(color), vget_high_u8(alpha));
+	// (x + 128 + ((x + 128) >> 8)) >> 8
+	return vcombine_u8(vraddhn_u16(low, vrshrq_n_u16(low, 8)), vraddhn_u16(high, vrshrq_n_u16(high, 8)));
+}
+static void convert_row_neon(unsigned char const *source, uint32_t *destination, int width) {
+	int x = 0;
+	for (; x + 16 <= width; x += 16) {
+		uint8x16x4_t rgba = vld4q_u8(source + x * 4);
+		uint8x16x4_t bgra;
+		bgra.val[0] = premultiply_neon(rgba.val[2], rgba.val[3]);
+		bgra.val[1] = premultiply_neon(rgba.val[1], rgba.val[3]);
+		bgra.val[2] = premultiply_neon(rgba.val[0], rgba.val[3]);
+		bgra.val[3] = rgba.val[3];
+		vst4q_u8((uint8_t *)(destination + x), bgra);
+	}
+	convert_row_scalar(source + x * 4, destination + x, width - x);
+}
+#endif
+
+#endif
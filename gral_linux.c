@@ -11,13 +11,20 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 */
 
 #include "gral.h"
+#include "gral_convert.h"
 #include <gtk/gtk.h>
 #include <gdk/gdkwayland.h>
 #include <stdlib.h>
+#include <math.h>
 #include <sys/inotify.h>
 #include <glib-unix.h>
 #include <pulse/pulseaudio.h>
 #include <alsa/asoundlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 /*================
@@ -86,20 +93,394 @@ int gral_application_run(struct gral_application *application, int argc, char **
     DRAWING
  ============*/
 
-static void pixbuf_destroy(guchar *pixels, gpointer data) {
-	free(pixels);
+static struct gral_draw_statistics draw_statistics;
+static struct gral_draw_statistics reset_draw_statistics;
+static struct gral_draw_statistics dumped_draw_statistics;
+static double draw_statistics_interval;
+static double last_draw_statistics_dump;
+G_LOCK_DEFINE_STATIC(draw_statistics);
+
+static void count_draw_statistic(size_t *counter, size_t value) {
+	// images are also created and converted on loader threads, so the counters only ever grow atomically and a reset records a baseline
+	g_atomic_pointer_add(counter, value);
+}
+
+static void get_draw_statistics(struct gral_draw_statistics *statistics) {
+	// the times are only changed with the lock held, which the caller holds as well
+	statistics->frames = (size_t)g_atomic_pointer_get(&draw_statistics.frames);
+	statistics->paths = (size_t)g_atomic_pointer_get(&draw_statistics.paths);
+	statistics->fills = (size_t)g_atomic_pointer_get(&draw_statistics.fills);
+	statistics->strokes = (size_t)g_atomic_pointer_get(&draw_statistics.strokes);
+	statistics->text_runs = (size_t)g_atomic_pointer_get(&draw_statistics.text_runs);
+	statistics->images = (size_t)g_atomic_pointer_get(&draw_statistics.images);
+	statistics->converted_bytes = (size_t)g_atomic_pointer_get(&draw_statistics.converted_bytes);
+	statistics->draw_time = draw_statistics.draw_time;
+	statistics->flush_time = draw_statistics.flush_time;
+}
+
+static void count_frame(double draw_time, double flush_time) {
+	// print the per-frame averages since the last dump to stderr if GRAL_DRAW_STATISTICS is set to an interval in seconds
+	double time = gral_time_get_monotonic();
+	G_LOCK(draw_statistics);
+	count_draw_statistic(&draw_statistics.frames, 1);
+	draw_statistics.draw_time += draw_time;
+	draw_statistics.flush_time += flush_time;
+	static gsize initialized = 0;
+	if (g_once_init_enter(&initialized)) {
+		char const *interval = g_getenv("GRAL_DRAW_STATISTICS");
+		if (interval) {
+			draw_statistics_interval = g_ascii_strtod(interval, NULL);
+		}
+		last_draw_statistics_dump = time;
+		g_once_init_leave(&initialized, 1);
+	}
+	if (draw_statistics_interval <= 0.0 || time - last_draw_statistics_dump < draw_statistics_interval) {
+		G_UNLOCK(draw_statistics);
+		return;
+	}
+	struct gral_draw_statistics current;
+	get_draw_statistics(&current);
+	double frames = current.frames - dumped_draw_statistics.frames;
+	if (frames > 0.0) {
+		fprintf(stderr, "libgral: %.0f frames, per frame: %.1f paths, %.1f fills, %.1f strokes, %.1f text runs, %.1f images, %.0f converted bytes, %.3f ms draw, %.3f ms flush\n",
+			frames,
+			(current.paths - dumped_draw_statistics.paths) / frames,
+			(current.fills - dumped_draw_statistics.fills) / frames,
+			(current.strokes - dumped_draw_statistics.strokes) / frames,
+			(current.text_runs - dumped_draw_statistics.text_runs) / frames,
+			(current.images - dumped_draw_statistics.images) / frames,
+			(current.converted_bytes - dumped_draw_statistics.converted_bytes) / frames,
+			(current.draw_time - dumped_draw_statistics.draw_time) * 1000.0 / frames,
+			(current.flush_time - dumped_draw_statistics.flush_time) * 1000.0 / frames
+		);
+	}
+	dumped_draw_statistics = current;
+	last_draw_statistics_dump = time;
+	G_UNLOCK(draw_statistics);
+}
+
+void gral_draw_statistics_get(struct gral_draw_statistics *statistics) {
+	struct gral_draw_statistics current;
+	G_LOCK(draw_statistics);
+	get_draw_statistics(&current);
+	statistics->frames = current.frames - reset_draw_statistics.frames;
+	statistics->paths = current.paths - reset_draw_statistics.paths;
+	statistics->fills = current.fills - reset_draw_statistics.fills;
+	statistics->strokes = current.strokes - reset_draw_statistics.strokes;
+	statistics->text_runs = current.text_runs - reset_draw_statistics.text_runs;
+	statistics->images = current.images - reset_draw_statistics.images;
+	statistics->converted_bytes = current.converted_bytes - reset_draw_statistics.converted_bytes;
+	statistics->draw_time = current.draw_time - reset_draw_statistics.draw_time;
+	statistics->flush_time = current.flush_time - reset_draw_statistics.flush_time;
+	G_UNLOCK(draw_statistics);
+}
+
+void gral_draw_statistics_reset(void) {
+	G_LOCK(draw_statistics);
+	get_draw_statistics(&reset_draw_statistics);
+	dumped_draw_statistics = reset_draw_statistics;
+	G_UNLOCK(draw_statistics);
+}
+
+static ConvertRowFunction get_convert_row_function(void) {
+	static gsize convert_row = 0;
+	if (g_once_init_enter(&convert_row)) {
+		ConvertRowFunction function = &convert_row_scalar;
+#if defined(HAVE_CONVERT_ROW_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) function = &convert_row_avx2;
+		else if (__builtin_cpu_supports("sse2")) function = &convert_row_sse2;
+#elif defined(HAVE_CONVERT_ROW_NEON)
+		function = &convert_row_neon;
+#endif
+		g_once_init_leave(&convert_row, (gsize)function);
+	}
+	return (ConvertRowFunction)convert_row;
+}
+static void convert_pixels(unsigned char const *source, int source_stride, unsigned char *destination, int destination_stride, int width, int height) {
+	// convert straight RGBA to premultiplied native-endian ARGB32
+	ConvertRowFunction convert_row = get_convert_row_function();
+	count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	for (int y = 0; y < height; y++) {
+		convert_row(source + y * source_stride, (uint32_t *)(destination + y * destination_stride), width);
+	}
+}
+
+static void image_free_data(void *data, void *user_data) {
+	free(data);
+}
+
+typedef struct {
+	void (*release)(void *data, void *user_data);
+	void *data;
+	void *user_data;
+} ImageReleaseData;
+static cairo_user_data_key_t image_release_key;
+static void image_release(void *user_data) {
+	ImageReleaseData *release_data = user_data;
+	if (release_data->release) {
+		release_data->release(release_data->data, release_data->user_data);
+	}
+	g_slice_free(ImageReleaseData, release_data);
+}
+
+static cairo_surface_t *create_image_surface(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data) {
+	if (format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA && G_BYTE_ORDER == G_LITTLE_ENDIAN && stride % 4 == 0) {
+		// premultiplied BGRA is Cairo's native format on little-endian machines and can be used without a copy
+		cairo_surface_t *surface = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, width, height, stride);
+		if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS) {
+			ImageReleaseData *release_data = g_slice_new(ImageReleaseData);
+			release_data->release = release;
+			release_data->data = data;
+			release_data->user_data = user_data;
+			if (cairo_surface_set_user_data(surface, &image_release_key, release_data, &image_release) == CAIRO_STATUS_SUCCESS) {
+				return surface;
+			}
+			g_slice_free(ImageReleaseData, release_data);
+		}
+		// Cairo rejected the data as it is, so fall back to a copy
+		cairo_surface_destroy(surface);
+	}
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		if (release) {
+			release(data, user_data);
+		}
+		return surface;
+	}
+	cairo_surface_flush(surface);
+	unsigned char *destination = cairo_image_surface_get_data(surface);
+	int destination_stride = cairo_image_surface_get_stride(surface);
+	if (format == GRAL_PIXEL_FORMAT_RGBA) {
+		convert_pixels(data, stride, destination, destination_stride, width, height);
+	}
+	else {
+		for (int y = 0; y < height; y++) {
+			unsigned char const *s = (unsigned char const *)data + y * stride;
+			guint32 *d = (guint32 *)(destination + y * destination_stride);
+			for (int x = 0; x < width; x++) {
+				d[x] = (guint32)s[3] << 24 | s[2] << 16 | s[1] << 8 | s[0];
+				s += 4;
+			}
+		}
+	}
+	cairo_surface_mark_dirty(surface);
+	if (release) {
+		release(data, user_data);
+	}
+	return surface;
 }
 
 struct gral_image *gral_image_create(int width, int height, void *data) {
-	return (struct gral_image *)gdk_pixbuf_new_from_data(data, GDK_COLORSPACE_RGB, TRUE, 8, width, height, width * 4, &pixbuf_destroy, NULL);
+	return (struct gral_image *)create_image_surface(width, height, width * 4, GRAL_PIXEL_FORMAT_RGBA, data, &image_free_data, NULL);
+}
+
+static cairo_user_data_key_t image_from_data_key;
+struct gral_image *gral_image_create_from_data(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data) {
+	cairo_surface_t *surface = create_image_surface(width, height, stride, format, data, release, user_data);
+	// the data may be read-only or used without a copy, so these images are never updated
+	cairo_surface_set_user_data(surface, &image_from_data_key, GINT_TO_POINTER(TRUE), NULL);
+	return (struct gral_image *)surface;
 }
 
 void gral_image_delete(struct gral_image *image) {
-	g_object_unref(image);
+	cairo_surface_destroy((cairo_surface_t *)image);
+}
+
+typedef void (*DownsampleRowFunction)(guint32 const *row0, guint32 const *row1, guint32 *destination, int width);
+static guint32 average_pixels(guint32 a, guint32 b, guint32 c, guint32 d) {
+	// average the four channels in two 16-bit lanes at a time
+	guint32 low = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+	guint32 high = (a >> 8 & 0x00FF00FF) + (b >> 8 & 0x00FF00FF) + (c >> 8 & 0x00FF00FF) + (d >> 8 & 0x00FF00FF) + 0x00020002;
+	return (low >> 2 & 0x00FF00FF) | (high >> 2 & 0x00FF00FF) << 8;
+}
+static void downsample_row_scalar(guint32 const *row0, guint32 const *row1, guint32 *destination, int width) {
+	for (int x = 0; x < width; x++) {
+		destination[x] = average_pixels(row0[x * 2], row0[x * 2 + 1], row1[x * 2], row1[x * 2 + 1]);
+	}
+}
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_DOWNSAMPLE_ROW_X86
+// the SIMD versions widen the channels to 16 bits and round exactly like average_pixels
+__attribute__((target("sse2"))) static __m128i sum_pixel_pairs_sse2(__m128i row0, __m128i row1) {
+	// returns the channel sums of the 2x2 blocks of two adjacent pixel pairs as 16-bit lanes
+	__m128i zero = _mm_setzero_si128();
+	__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+	__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+	low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+	high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+	return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_set1_epi16(2)), 2);
+}
+__attribute__((target("sse2"))) static void downsample_row_sse2(guint32 const *row0, guint32 const *row1, guint32 *destination, int width) {
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i a = sum_pixel_pairs_sse2(_mm_loadu_si128((__m128i const *)(row0 + x * 2)), _mm_loadu_si128((__m128i const *)(row1 + x * 2)));
+		__m128i b = sum_pixel_pairs_sse2(_mm_loadu_si128((__m128i const *)(row0 + x * 2 + 4)), _mm_loadu_si128((__m128i const *)(row1 + x * 2 + 4)));
+		_mm_storeu_si128((__m128i *)(destination + x), _mm_packus_epi16(a, b));
+	}
+	downsample_row_scalar(row0 + x * 2, row1 + x * 2, destination + x, width - x);
+}
+__attribute__((target("avx2"))) static __m256i sum_pixel_pairs_avx2(__m256i row0, __m256i row1) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i low = _mm256_add_epi16(_mm256_unpacklo_epi8(row0, zero), _mm256_unpacklo_epi8(row1, zero));
+	__m256i high = _mm256_add_epi16(_mm256_unpackhi_epi8(row0, zero), _mm256_unpackhi_epi8(row1, zero));
+	low = _mm256_add_epi16(low, _mm256_srli_si256(low, 8));
+	high = _mm256_add_epi16(high, _mm256_srli_si256(high, 8));
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(low, high), _mm256_set1_epi16(2)), 2);
+}
+__attribute__((target("avx2"))) static void downsample_row_avx2(guint32 const *row0, guint32 const *row1, guint32 *destination, int width) {
+	int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i a = sum_pixel_pairs_avx2(_mm256_loadu_si256((__m256i const *)(row0 + x * 2)), _mm256_loadu_si256((__m256i const *)(row1 + x * 2)));
+		__m256i b = sum_pixel_pairs_avx2(_mm256_loadu_si256((__m256i const *)(row0 + x * 2 + 8)), _mm256_loadu_si256((__m256i const *)(row1 + x * 2 + 8)));
+		// the unpacks and the pack operate within 128-bit lanes, so the two middle quarters are swapped
+		_mm256_storeu_si256((__m256i *)(destination + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	downsample_row_sse2(row0 + x * 2, row1 + x * 2, destination + x, width - x);
+}
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define HAVE_DOWNSAMPLE_ROW_NEON
+static void downsample_row_neon(guint32 const *row0, guint32 const *row1, guint32 *destination, int width) {
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		uint32x4x2_t a = vld2q_u32(row0 + x * 2);
+		uint32x4x2_t b = vld2q_u32(row1 + x * 2);
+		uint8x16_t a_even = vreinterpretq_u8_u32(a.val[0]), a_odd = vreinterpretq_u8_u32(a.val[1]);
+		uint8x16_t b_even = vreinterpretq_u8_u32(b.val[0]), b_odd = vreinterpretq_u8_u32(b.val[1]);
+		// widen to 16 bits and let the rounding narrowing shift compute (a + b + c + d + 2) >> 2
+		uint16x8_t low = vaddq_u16(vaddl_u8(vget_low_u8(a_even), vget_low_u8(a_odd)), vaddl_u8(vget_low_u8(b_even), vget_low_u8(b_odd)));
+		uint16x8_t high = vaddq_u16(vaddl_u8(vget_high_u8(a_even), vget_high_u8(a_odd)), vaddl_u8(vget_high_u8(b_even), vget_high_u8(b_odd)));
+		vst1q_u32(destination + x, vreinterpretq_u32_u8(vcombine_u8(vrshrn_n_u16(low, 2), vrshrn_n_u16(high, 2))));
+	}
+	downsample_row_scalar(row0 + x * 2, row1 + x * 2, destination + x, width - x);
+}
+#endif
+static DownsampleRowFunction get_downsample_row_function(void) {
+	static gsize downsample_row = 0;
+	if (g_once_init_enter(&downsample_row)) {
+		DownsampleRowFunction function = &downsample_row_scalar;
+#if defined(HAVE_DOWNSAMPLE_ROW_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) function = &downsample_row_avx2;
+		else if (__builtin_cpu_supports("sse2")) function = &downsample_row_sse2;
+#elif defined(HAVE_DOWNSAMPLE_ROW_NEON)
+		function = &downsample_row_neon;
+#endif
+		g_once_init_leave(&downsample_row, (gsize)function);
+	}
+	return (DownsampleRowFunction)downsample_row;
+}
+static cairo_surface_t *downsample(cairo_surface_t *source) {
+	// halve the size with a 2x2 box filter, the premultiplied pixels can be averaged directly
+	// odd sizes are rounded up and the last column and row are repeated, so every pixel keeps covering exactly two source pixels
+	DownsampleRowFunction downsample_row = get_downsample_row_function();
+	int source_width = cairo_image_surface_get_width(source);
+	int source_height = cairo_image_surface_get_height(source);
+	int source_stride = cairo_image_surface_get_stride(source);
+	int width = (source_width + 1) / 2;
+	int height = (source_height + 1) / 2;
+	cairo_surface_t *destination = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	cairo_surface_flush(source);
+	cairo_surface_flush(destination);
+	unsigned char const *source_data = cairo_image_surface_get_data(source);
+	unsigned char *destination_data = cairo_image_surface_get_data(destination);
+	int destination_stride = cairo_image_surface_get_stride(destination);
+	for (int y = 0; y < height; y++) {
+		guint32 const *row0 = (guint32 const *)(source_data + y * 2 * source_stride);
+		guint32 const *row1 = (guint32 const *)(source_data + MIN(y * 2 + 1, source_height - 1) * source_stride);
+		guint32 *row = (guint32 *)(destination_data + y * destination_stride);
+		downsample_row(row0, row1, row, source_width / 2);
+		if (source_width % 2 == 1) {
+			row[width - 1] = average_pixels(row0[source_width - 1], row0[source_width - 1], row1[source_width - 1], row1[source_width - 1]);
+		}
+	}
+	cairo_surface_mark_dirty(destination);
+	return destination;
+}
+
+#define MIPMAP_MAX_LEVELS 16
+typedef struct {
+	int level_count;
+	cairo_surface_t *levels[MIPMAP_MAX_LEVELS]; // levels[0] is half the size of the image
+} Mipmaps;
+static cairo_user_data_key_t mipmaps_key;
+G_LOCK_DEFINE_STATIC(mipmaps);
+static void mipmaps_free(void *data) {
+	Mipmaps *mipmaps = data;
+	for (int i = 0; i < mipmaps->level_count; i++) {
+		cairo_surface_destroy(mipmaps->levels[i]);
+	}
+	g_slice_free(Mipmaps, mipmaps);
+}
+static cairo_surface_t *get_mipmap(cairo_surface_t *surface, int *level) {
+	// the levels are computed on first use and live as long as the image is not updated
+	G_LOCK(mipmaps);
+	Mipmaps *mipmaps = cairo_surface_get_user_data(surface, &mipmaps_key);
+	if (mipmaps == NULL) {
+		mipmaps = g_slice_new(Mipmaps);
+		mipmaps->level_count = 0;
+		cairo_surface_set_user_data(surface, &mipmaps_key, mipmaps, &mipmaps_free);
+	}
+	while (mipmaps->level_count < *level && mipmaps->level_count < MIPMAP_MAX_LEVELS) {
+		cairo_surface_t *source = mipmaps->level_count > 0 ? mipmaps->levels[mipmaps->level_count - 1] : surface;
+		if (cairo_image_surface_get_width(source) == 1 && cairo_image_surface_get_height(source) == 1) {
+			break;
+		}
+		mipmaps->levels[mipmaps->level_count++] = downsample(source);
+	}
+	*level = MIN(*level, mipmaps->level_count);
+	cairo_surface_t *result = cairo_surface_reference(*level > 0 ? mipmaps->levels[*level - 1] : surface);
+	G_UNLOCK(mipmaps);
+	return result;
+}
+
+void gral_image_update(struct gral_image *image, int x, int y, int width, int height, void const *data) {
+	cairo_surface_t *surface = (cairo_surface_t *)image;
+	g_return_if_fail(cairo_surface_get_user_data(surface, &image_from_data_key) == NULL);
+	// only the part of the rectangle that lies within the image is updated
+	unsigned char const *source = data;
+	int source_stride = width * 4;
+	if (x < 0) {
+		source -= x * 4;
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		source -= y * source_stride;
+		height += y;
+		y = 0;
+	}
+	width = MIN(width, cairo_image_surface_get_width(surface) - x);
+	height = MIN(height, cairo_image_surface_get_height(surface) - y);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	cairo_surface_flush(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	convert_pixels(source, source_stride, cairo_image_surface_get_data(surface) + y * stride + x * 4, stride, width, height);
+	cairo_surface_mark_dirty_rectangle(surface, x, y, width, height);
+	G_LOCK(mipmaps);
+	cairo_surface_set_user_data(surface, &mipmaps_key, NULL, NULL);
+	G_UNLOCK(mipmaps);
+}
+
+static PangoContext *get_pango_context(struct gral_window *window) {
+	if (window) {
+		return gtk_widget_get_pango_context(GTK_WIDGET(window));
+	}
+	// fonts and texts created without a window are used with headless draw contexts
+	static PangoContext *headless_context;
+	if (headless_context == NULL) {
+		headless_context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+		PangoFontDescription *font = pango_font_description_from_string("Sans 10");
+		pango_context_set_font_description(headless_context, font);
+		pango_font_description_free(font);
+	}
+	return headless_context;
 }
 
 struct gral_font *gral_font_create(struct gral_window *window, char const *name, float size) {
-	PangoContext *context = gtk_widget_get_pango_context(GTK_WIDGET(window));
+	PangoContext *context = get_pango_context(window);
 	PangoFontDescription *font = pango_font_description_copy(pango_context_get_font_description(context));
 	pango_font_description_set_family(font, name);
 	pango_font_description_set_absolute_size(font, pango_units_from_double(size));
@@ -107,7 +488,7 @@ struct gral_font *gral_font_create(struct gral_window *window, char const *name,
 }
 
 struct gral_font *gral_font_create_default(struct gral_window *window, float size) {
-	PangoContext *context = gtk_widget_get_pango_context(GTK_WIDGET(window));
+	PangoContext *context = get_pango_context(window);
 	PangoFontDescription *font = pango_font_description_copy(pango_context_get_font_description(context));
 	pango_font_description_set_absolute_size(font, pango_units_from_double(size));
 	return (struct gral_font *)font;
@@ -128,7 +509,7 @@ struct gral_font *gral_font_create_monospace(struct gral_window *window, float s
 			return (struct gral_font *)font;
 		}
 	}
-	PangoContext *context = gtk_widget_get_pango_context(GTK_WIDGET(window));
+	PangoContext *context = get_pango_context(window);
 	PangoFontDescription *font = pango_font_description_copy(pango_context_get_font_description(context));
 	pango_font_description_set_family_static(font, "monospace");
 	pango_font_description_set_absolute_size(font, pango_units_from_double(size));
@@ -140,33 +521,249 @@ void gral_font_delete(struct gral_font *font) {
 }
 
 void gral_font_get_metrics(struct gral_window *window, struct gral_font *font, float *ascent, float *descent) {
-	PangoContext *context = gtk_widget_get_pango_context(GTK_WIDGET(window));
+	PangoContext *context = get_pango_context(window);
 	PangoFontMetrics *metrics = pango_context_get_metrics(context, (PangoFontDescription *)font, NULL);
 	if (ascent) *ascent = pango_units_to_double(pango_font_metrics_get_ascent(metrics));
 	if (descent) *descent = pango_units_to_double(pango_font_metrics_get_descent(metrics));
 	pango_font_metrics_unref(metrics);
 }
 
-struct gral_text *gral_text_create(struct gral_window *window, char const *text, struct gral_font *font) {
-	PangoContext *context = gtk_widget_get_pango_context(GTK_WIDGET(window));
-	PangoLayout *layout = pango_layout_new(context);
-	pango_layout_set_text(layout, text, -1);
-	pango_layout_set_font_description(layout, (PangoFontDescription *)font);
+typedef struct {
+	PangoFont *font;
+	cairo_scaled_font_t *scaled_font;
+	unsigned long glyphs[95];
+	double advance;
+	double ascent;
+	double descent;
+} MonospaceGlyphs;
+
+// sequences that programming fonts commonly turn into ligatures or contextual alternates
+static char const monospace_ligature_probe[] = "-> => <- <= >= != == === !== :: ... // /* */ ** && || ++ -- <> |> <| ## #{ 0x www fi fl ff";
+
+static MonospaceGlyphs *create_monospace_glyphs(PangoContext *context, PangoFontDescription const *font) {
+	// shape the printable ASCII characters forward and backward and check that every character maps to one glyph of the same width regardless of its neighbors
+	// fonts that form ligatures or contextual alternates for any of the probe sequences are left to Pango
+	char characters[3][96];
+	for (int i = 0; i < 95; i++) {
+		characters[0][i] = 0x20 + i;
+		characters[1][i] = 0x7E - i;
+	}
+	characters[0][95] = characters[1][95] = '\0';
+	g_strlcpy(characters[2], monospace_ligature_probe, sizeof(characters[2]));
+	MonospaceGlyphs *result = g_slice_new0(MonospaceGlyphs);
+	gboolean is_monospace = TRUE;
+	for (int j = 0; j < 3 && is_monospace; j++) {
+		int length = strlen(characters[j]);
+		PangoLayout *layout = pango_layout_new(context);
+		pango_layout_set_font_description(layout, font);
+		pango_layout_set_text(layout, characters[j], length);
+		PangoLayoutLine *line = pango_layout_get_line_readonly(layout, 0);
+		if (line->runs == NULL || line->runs->next != NULL) {
+			is_monospace = FALSE;
+		}
+		else {
+			PangoGlyphItem *run = line->runs->data;
+			PangoGlyphString *glyphs = run->glyphs;
+			if (j == 0) {
+				result->font = g_object_ref(run->item->analysis.font);
+				result->advance = pango_units_to_double(glyphs->glyphs[0].geometry.width);
+			}
+			is_monospace = run->item->analysis.font == result->font && glyphs->num_glyphs == length;
+			for (int i = 0; i < glyphs->num_glyphs && is_monospace; i++) {
+				PangoGlyphInfo *info = &glyphs->glyphs[i];
+				int c = characters[j][i] - 0x20;
+				if (glyphs->log_clusters[i] != i || info->glyph & PANGO_GLYPH_UNKNOWN_FLAG || info->geometry.x_offset != 0 || info->geometry.y_offset != 0 || pango_units_to_double(info->geometry.width) != result->advance) {
+					is_monospace = FALSE;
+				}
+				else if (j == 0) {
+					result->glyphs[c] = info->glyph;
+				}
+				else if (result->glyphs[c] != info->glyph) {
+					is_monospace = FALSE;
+				}
+			}
+		}
+		g_object_unref(layout);
+	}
+	if (is_monospace) {
+		result->scaled_font = pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(result->font));
+		cairo_font_extents_t extents;
+		cairo_scaled_font_extents(result->scaled_font, &extents);
+		result->ascent = extents.ascent;
+		result->descent = extents.descent;
+	}
+	return result;
+}
+
+static void monospace_glyphs_free(gpointer data) {
+	MonospaceGlyphs *glyphs = data;
+	if (glyphs->font) {
+		g_object_unref(glyphs->font);
+	}
+	g_slice_free(MonospaceGlyphs, glyphs);
+}
+
+static MonospaceGlyphs *get_monospace_glyphs(PangoLayout *layout) {
+	// the glyphs are stored on the context, which lives as long as any layout that uses it
+	PangoContext *context = pango_layout_get_context(layout);
+	GHashTable *monospace_glyphs = g_object_get_data(G_OBJECT(context), "gral-monospace-glyphs");
+	if (monospace_glyphs == NULL) {
+		monospace_glyphs = g_hash_table_new_full(&g_str_hash, &g_str_equal, &g_free, &monospace_glyphs_free);
+		g_object_set_data_full(G_OBJECT(context), "gral-monospace-glyphs", monospace_glyphs, (GDestroyNotify)&g_hash_table_unref);
+	}
+	// the glyphs and their advance also depend on the resolution and the font options of the context
+	cairo_font_options_t const *font_options = pango_cairo_context_get_font_options(context);
+	char *font_string = pango_font_description_to_string(pango_layout_get_font_description(layout));
+	char *key = g_strdup_printf("%s\n%g\n%lu", font_string, pango_cairo_context_get_resolution(context), font_options ? cairo_font_options_hash(font_options) : 0ul);
+	g_free(font_string);
+	MonospaceGlyphs *glyphs = g_hash_table_lookup(monospace_glyphs, key);
+	if (glyphs == NULL) {
+		glyphs = create_monospace_glyphs(context, pango_layout_get_font_description(layout));
+		g_hash_table_insert(monospace_glyphs, key, glyphs);
+	}
+	else {
+		g_free(key);
+	}
+	return glyphs->scaled_font ? glyphs : NULL;
+}
+
+struct gral_text {
+	PangoLayout *layout;
+	gboolean is_shared;
+	gboolean has_attributes;
+	int ascii_length; // the length of the text if it consists of printable ASCII characters only, -1 otherwise
+	MonospaceGlyphs *monospace_glyphs;
+	gboolean has_monospace_glyphs;
+};
+
+static MonospaceGlyphs *get_text_monospace_glyphs(struct gral_text *text) {
+	// texts without attributes that consist of printable ASCII characters in a monospace font can be measured and drawn without Pango
+	if (text->ascii_length < 0 || text->has_attributes) {
+		return NULL;
+	}
+	if (!text->has_monospace_glyphs) {
+		text->monospace_glyphs = get_monospace_glyphs(text->layout);
+		text->has_monospace_glyphs = TRUE;
+	}
+	return text->monospace_glyphs;
+}
+
+typedef struct {
+	char *key;
+	PangoLayout *layout;
+} TextCacheEntry;
+static struct {
+	int capacity;
+	GHashTable *entries;
+	GQueue queue;
+	size_t hits;
+	size_t misses;
+} text_cache;
+
+static void text_cache_evict(int capacity) {
+	while ((int)text_cache.queue.length > capacity) {
+		TextCacheEntry *entry = g_queue_pop_tail(&text_cache.queue);
+		g_hash_table_remove(text_cache.entries, entry->key);
+		g_free(entry->key);
+		g_object_unref(entry->layout);
+		g_slice_free(TextCacheEntry, entry);
+	}
+}
+
+static gboolean append_attribute_to_key(PangoAttribute *attribute, gpointer user_data) {
+	GString *key = user_data;
+	g_string_append_printf(key, "%d:%u:%u:", attribute->klass->type, attribute->start_index, attribute->end_index);
+	if (attribute->klass->type == PANGO_ATTR_FOREGROUND) {
+		PangoColor *color = &((PangoAttrColor *)attribute)->color;
+		g_string_append_printf(key, "%04x%04x%04x;", color->red, color->green, color->blue);
+	}
+	else {
+		g_string_append_printf(key, "%d;", ((PangoAttrInt *)attribute)->value);
+	}
+	return FALSE;
+}
+
+static PangoLayout *get_layout(struct gral_text *text) {
+	// look up an already shaped layout with the same text, font, and attributes
+	if (text_cache.capacity == 0 || text->is_shared) {
+		return text->layout;
+	}
+	PangoFontDescription const *font = pango_layout_get_font_description(text->layout);
+	char *font_string = pango_font_description_to_string(font);
+	GString *key = g_string_new(NULL);
+	g_string_append_printf(key, "%p\n%s\n", (void *)pango_layout_get_context(text->layout), font_string);
+	g_free(font_string);
+	pango_attr_list_filter(pango_layout_get_attributes(text->layout), &append_attribute_to_key, key);
+	g_string_append_c(key, '\n');
+	g_string_append(key, pango_layout_get_text(text->layout));
+	GList *link = g_hash_table_lookup(text_cache.entries, key->str);
+	if (link) {
+		TextCacheEntry *entry = link->data;
+		g_queue_unlink(&text_cache.queue, link);
+		g_queue_push_head_link(&text_cache.queue, link);
+		g_object_unref(text->layout);
+		text->layout = g_object_ref(entry->layout);
+		text_cache.hits++;
+		g_string_free(key, TRUE);
+	}
+	else {
+		TextCacheEntry *entry = g_slice_new(TextCacheEntry);
+		entry->key = g_string_free(key, FALSE);
+		entry->layout = g_object_ref(text->layout);
+		g_queue_push_head(&text_cache.queue, entry);
+		g_hash_table_insert(text_cache.entries, entry->key, text_cache.queue.head);
+		text_cache.misses++;
+		text_cache_evict(text_cache.capacity);
+	}
+	text->is_shared = TRUE;
+	return text->layout;
+}
+
+static PangoAttrList *get_attributes(struct gral_text *text) {
+	if (text->is_shared) {
+		// the layout is shared with the cache, so modify a copy
+		PangoLayout *layout = pango_layout_copy(text->layout);
+		g_object_unref(text->layout);
+		text->layout = layout;
+		text->is_shared = FALSE;
+	}
+	text->has_attributes = TRUE;
+	return pango_layout_get_attributes(text->layout);
+}
+
+struct gral_text *gral_text_create(struct gral_window *window, char const *utf8, struct gral_font *font) {
+	PangoContext *context = get_pango_context(window);
+	struct gral_text *text = g_slice_new(struct gral_text);
+	text->layout = pango_layout_new(context);
+	text->is_shared = FALSE;
+	text->has_attributes = FALSE;
+	text->ascii_length = 0;
+	while (utf8[text->ascii_length] >= 0x20 && utf8[text->ascii_length] <= 0x7E) {
+		text->ascii_length++;
+	}
+	if (utf8[text->ascii_length] != '\0') {
+		text->ascii_length = -1;
+	}
+	text->monospace_glyphs = NULL;
+	text->has_monospace_glyphs = FALSE;
+	pango_layout_set_text(text->layout, utf8, -1);
+	pango_layout_set_font_description(text->layout, (PangoFontDescription *)font);
 	PangoAttrList *attributes = pango_attr_list_new();
-	pango_layout_set_attributes(layout, attributes);
+	pango_layout_set_attributes(text->layout, attributes);
 	pango_attr_list_unref(attributes);
-	return (struct gral_text *)layout;
+	return text;
 }
 
 void gral_text_delete(struct gral_text *text) {
-	g_object_unref(text);
+	g_object_unref(text->layout);
+	g_slice_free(struct gral_text, text);
 }
 
 void gral_text_set_bold(struct gral_text *text, int start_index, int end_index) {
 	PangoAttribute *attribute = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
 	attribute->start_index = start_index;
 	attribute->end_index = end_index;
-	PangoAttrList *attributes = pango_layout_get_attributes(PANGO_LAYOUT(text));
+	PangoAttrList *attributes = get_attributes(text);
 	pango_attr_list_change(attributes, attribute);
 }
 
@@ -174,7 +771,7 @@ void gral_text_set_italic(struct gral_text *text, int start_index, int end_index
 	PangoAttribute *attribute = pango_attr_style_new(PANGO_STYLE_ITALIC);
 	attribute->start_index = start_index;
 	attribute->end_index = end_index;
-	PangoAttrList *attributes = pango_layout_get_attributes(PANGO_LAYOUT(text));
+	PangoAttrList *attributes = get_attributes(text);
 	pango_attr_list_change(attributes, attribute);
 }
 
@@ -182,7 +779,7 @@ void gral_text_set_color(struct gral_text *text, int start_index, int end_index,
 	PangoAttribute *attribute = pango_attr_foreground_new(red * 65535.0f, green * 65535.0f, blue * 65535.0f);
 	attribute->start_index = start_index;
 	attribute->end_index = end_index;
-	PangoAttrList *attributes = pango_layout_get_attributes(PANGO_LAYOUT(text));
+	PangoAttrList *attributes = get_attributes(text);
 	pango_attr_list_change(attributes, attribute);
 	attribute = pango_attr_foreground_alpha_new(alpha * 65535.0f);
 	attribute->start_index = start_index;
@@ -190,53 +787,725 @@ void gral_text_set_color(struct gral_text *text, int start_index, int end_index,
 	pango_attr_list_change(attributes, attribute);
 }
 
+static void insert_span_attribute(PangoAttrList *attributes, gboolean append, PangoAttribute *attribute, struct gral_text_span const *span) {
+	attribute->start_index = span->start_index;
+	attribute->end_index = span->end_index;
+	if (append) {
+		pango_attr_list_insert(attributes, attribute);
+	}
+	else {
+		pango_attr_list_change(attributes, attribute);
+	}
+}
+
+void gral_text_set_spans(struct gral_text *text, struct gral_text_span const *spans, int count) {
+	// if the text has no attributes yet, the sorted spans are appended to a new list in a single pass and the layout is invalidated only once
+	if (count == 0) {
+		return;
+	}
+	gboolean append = !text->has_attributes;
+	PangoAttrList *attributes = append ? pango_attr_list_new() : pango_attr_list_ref(get_attributes(text));
+	for (int i = 0; i < count; i++) {
+		struct gral_text_span const *span = &spans[i];
+		if (span->style & GRAL_TEXT_STYLE_BOLD) {
+			insert_span_attribute(attributes, append, pango_attr_weight_new(PANGO_WEIGHT_BOLD), span);
+		}
+		if (span->style & GRAL_TEXT_STYLE_ITALIC) {
+			insert_span_attribute(attributes, append, pango_attr_style_new(PANGO_STYLE_ITALIC), span);
+		}
+		insert_span_attribute(attributes, append, pango_attr_foreground_new(span->red * 65535.0f, span->green * 65535.0f, span->blue * 65535.0f), span);
+		insert_span_attribute(attributes, append, pango_attr_foreground_alpha_new(span->alpha * 65535.0f), span);
+	}
+	if (append) {
+		get_attributes(text);
+		pango_layout_set_attributes(text->layout, attributes);
+	}
+	pango_attr_list_unref(attributes);
+}
+
 float gral_text_get_width(struct gral_text *text) {
+	MonospaceGlyphs *monospace_glyphs = get_text_monospace_glyphs(text);
+	if (monospace_glyphs) {
+		return text->ascii_length * monospace_glyphs->advance;
+	}
 	PangoRectangle extents;
-	pango_layout_get_extents(PANGO_LAYOUT(text), NULL, &extents);
+	pango_layout_get_extents(get_layout(text), NULL, &extents);
 	return pango_units_to_double(extents.width);
 }
 
 float gral_text_index_to_x(struct gral_text *text, int index) {
-	PangoLayoutLine *line = pango_layout_get_line_readonly(PANGO_LAYOUT(text), 0);
+	MonospaceGlyphs *monospace_glyphs = get_text_monospace_glyphs(text);
+	if (monospace_glyphs) {
+		return index * monospace_glyphs->advance;
+	}
+	PangoLayoutLine *line = pango_layout_get_line_readonly(get_layout(text), 0);
 	int x;
 	pango_layout_line_index_to_x(line, index, FALSE, &x);
 	return pango_units_to_double(x);
 }
 
 int gral_text_x_to_index(struct gral_text *text, float x) {
-	PangoLayoutLine *line = pango_layout_get_line_readonly(PANGO_LAYOUT(text), 0);
+	MonospaceGlyphs *monospace_glyphs = get_text_monospace_glyphs(text);
+	if (monospace_glyphs) {
+		int index = (int)(x / monospace_glyphs->advance + 0.5f);
+		return CLAMP(index, 0, text->ascii_length);
+	}
+	PangoLayoutLine *line = pango_layout_get_line_readonly(get_layout(text), 0);
 	int index, trailing;
 	pango_layout_line_x_to_index(line, pango_units_from_double(x), &index, &trailing);
-	char const *str = pango_layout_get_text(PANGO_LAYOUT(text));
+	char const *str = pango_layout_get_text(get_layout(text));
 	return g_utf8_offset_to_pointer(str + index, trailing) - str;
 }
 
+void gral_text_cache_set_capacity(int capacity) {
+	if (text_cache.entries == NULL) {
+		text_cache.entries = g_hash_table_new(&g_str_hash, &g_str_equal);
+	}
+	text_cache_evict(capacity);
+	text_cache.capacity = capacity;
+}
+
+void gral_text_cache_get_statistics(size_t *hits, size_t *misses) {
+	if (hits) *hits = text_cache.hits;
+	if (misses) *misses = text_cache.misses;
+}
+
+struct gral_path {
+	GArray *data; // cairo_path_data_t
+};
+
+struct gral_path *gral_path_create(void) {
+	struct gral_path *path = g_slice_new(struct gral_path);
+	path->data = g_array_new(FALSE, FALSE, sizeof(cairo_path_data_t));
+	return path;
+}
+
+void gral_path_delete(struct gral_path *path) {
+	g_array_free(path->data, TRUE);
+	g_slice_free(struct gral_path, path);
+}
+
+static void append_path_header(struct gral_path *path, cairo_path_data_type_t type, int length) {
+	cairo_path_data_t data;
+	data.header.type = type;
+	data.header.length = length;
+	g_array_append_val(path->data, data);
+}
+
+static void append_path_point(struct gral_path *path, float x, float y) {
+	cairo_path_data_t data;
+	data.point.x = x;
+	data.point.y = y;
+	g_array_append_val(path->data, data);
+}
+
+void gral_path_close_path(struct gral_path *path) {
+	append_path_header(path, CAIRO_PATH_CLOSE_PATH, 1);
+}
+
+void gral_path_move_to(struct gral_path *path, float x, float y) {
+	append_path_header(path, CAIRO_PATH_MOVE_TO, 2);
+	append_path_point(path, x, y);
+}
+
+void gral_path_line_to(struct gral_path *path, float x, float y) {
+	append_path_header(path, CAIRO_PATH_LINE_TO, 2);
+	append_path_point(path, x, y);
+}
+
+void gral_path_curve_to(struct gral_path *path, float x1, float y1, float x2, float y2, float x, float y) {
+	append_path_header(path, CAIRO_PATH_CURVE_TO, 4);
+	append_path_point(path, x1, y1);
+	append_path_point(path, x2, y2);
+	append_path_point(path, x, y);
+}
+
+typedef void (*MinMaxFunction)(float const *minimum, float const *maximum, int count, float *min, float *max);
+static void min_max_scalar(float const *minimum, float const *maximum, int count, float *min, float *max) {
+	for (int i = 0; i < count; i++) {
+		if (minimum[i] < *min) *min = minimum[i];
+		if (maximum[i] > *max) *max = maximum[i];
+	}
+}
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_MIN_MAX_X86
+__attribute__((target("sse"))) static void min_max_sse(float const *minimum, float const *maximum, int count, float *min, float *max) {
+	int i = 0;
+	if (count >= 4) {
+		__m128 min4 = _mm_loadu_ps(minimum);
+		__m128 max4 = _mm_loadu_ps(maximum);
+		for (i = 4; i + 4 <= count; i += 4) {
+			min4 = _mm_min_ps(min4, _mm_loadu_ps(minimum + i));
+			max4 = _mm_max_ps(max4, _mm_loadu_ps(maximum + i));
+		}
+		float mins[4], maxs[4];
+		_mm_storeu_ps(mins, min4);
+		_mm_storeu_ps(maxs, max4);
+		min_max_scalar(mins, maxs, 4, min, max);
+	}
+	min_max_scalar(minimum + i, maximum + i, count - i, min, max);
+}
+__attribute__((target("avx"))) static void min_max_avx(float const *minimum, float const *maximum, int count, float *min, float *max) {
+	int i = 0;
+	if (count >= 8) {
+		__m256 min8 = _mm256_loadu_ps(minimum);
+		__m256 max8 = _mm256_loadu_ps(maximum);
+		for (i = 8; i + 8 <= count; i += 8) {
+			min8 = _mm256_min_ps(min8, _mm256_loadu_ps(minimum + i));
+			max8 = _mm256_max_ps(max8, _mm256_loadu_ps(maximum + i));
+		}
+		float mins[8], maxs[8];
+		_mm256_storeu_ps(mins, min8);
+		_mm256_storeu_ps(maxs, max8);
+		min_max_scalar(mins, maxs, 8, min, max);
+	}
+	min_max_sse(minimum + i, maximum + i, count - i, min, max);
+}
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define HAVE_MIN_MAX_NEON
+static void min_max_neon(float const *minimum, float const *maximum, int count, float *min, float *max) {
+	int i = 0;
+	if (count >= 4) {
+		float32x4_t min4 = vld1q_f32(minimum);
+		float32x4_t max4 = vld1q_f32(maximum);
+		for (i = 4; i + 4 <= count; i += 4) {
+			min4 = vminq_f32(min4, vld1q_f32(minimum + i));
+			max4 = vmaxq_f32(max4, vld1q_f32(maximum + i));
+		}
+		float mins[4], maxs[4];
+		vst1q_f32(mins, min4);
+		vst1q_f32(maxs, max4);
+		min_max_scalar(mins, maxs, 4, min, max);
+	}
+	min_max_scalar(minimum + i, maximum + i, count - i, min, max);
+}
+#endif
+static MinMaxFunction get_min_max_function(void) {
+	static gsize min_max = 0;
+	if (g_once_init_enter(&min_max)) {
+		MinMaxFunction function = &min_max_scalar;
+#if defined(HAVE_MIN_MAX_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx")) function = &min_max_avx;
+		else if (__builtin_cpu_supports("sse")) function = &min_max_sse;
+#elif defined(HAVE_MIN_MAX_NEON)
+		function = &min_max_neon;
+#endif
+		g_once_init_leave(&min_max, (gsize)function);
+	}
+	return (MinMaxFunction)min_max;
+}
+
+#define SAMPLE_PYRAMID_FACTOR 8
+#define SAMPLE_PYRAMID_MAX_LEVELS 10
+typedef struct {
+	float *minimum;
+	float *maximum;
+} SamplePyramidLevel;
+struct gral_sample_pyramid {
+	int level_count;
+	SamplePyramidLevel levels[SAMPLE_PYRAMID_MAX_LEVELS];
+};
+
+struct gral_sample_pyramid *gral_sample_pyramid_create(float const *samples, int count) {
+	// level n stores the minimum and maximum of blocks of SAMPLE_PYRAMID_FACTOR^(n+1) samples
+	MinMaxFunction min_max = get_min_max_function();
+	struct gral_sample_pyramid *pyramid = g_slice_new(struct gral_sample_pyramid);
+	pyramid->level_count = 0;
+	float const *minimum = samples;
+	float const *maximum = samples;
+	while (count > SAMPLE_PYRAMID_FACTOR && pyramid->level_count < SAMPLE_PYRAMID_MAX_LEVELS) {
+		int block_count = (count + SAMPLE_PYRAMID_FACTOR - 1) / SAMPLE_PYRAMID_FACTOR;
+		SamplePyramidLevel *level = &pyramid->levels[pyramid->level_count];
+		level->minimum = g_new(float, block_count);
+		level->maximum = g_new(float, block_count);
+		for (int i = 0; i < block_count; i++) {
+			int start = i * SAMPLE_PYRAMID_FACTOR;
+			level->minimum[i] = minimum[start];
+			level->maximum[i] = maximum[start];
+			min_max(minimum + start, maximum + start, MIN(SAMPLE_PYRAMID_FACTOR, count - start), &level->minimum[i], &level->maximum[i]);
+		}
+		minimum = level->minimum;
+		maximum = level->maximum;
+		count = block_count;
+		pyramid->level_count++;
+	}
+	return pyramid;
+}
+
+void gral_sample_pyramid_delete(struct gral_sample_pyramid *pyramid) {
+	for (int i = 0; i < pyramid->level_count; i++) {
+		g_free(pyramid->levels[i].minimum);
+		g_free(pyramid->levels[i].maximum);
+	}
+	g_slice_free(struct gral_sample_pyramid, pyramid);
+}
+
+static void get_samples_min_max(MinMaxFunction min_max, float const *samples, struct gral_sample_pyramid const *pyramid, int start, int end, float *min, float *max) {
+	// use the coarsest level that covers at least two whole blocks and scan the remainders on both sides with finer levels
+	int level = -1;
+	int block_size = 1;
+	if (pyramid) {
+		while (level + 1 < pyramid->level_count && end - start >= block_size * SAMPLE_PYRAMID_FACTOR * 2) {
+			level++;
+			block_size *= SAMPLE_PYRAMID_FACTOR;
+		}
+	}
+	if (level < 0) {
+		min_max(samples + start, samples + start, end - start, min, max);
+		return;
+	}
+	int first_block = (start + block_size - 1) / block_size;
+	int last_block = end / block_size;
+	min_max(pyramid->levels[level].minimum + first_block, pyramid->levels[level].maximum + first_block, last_block - first_block, min, max);
+	get_samples_min_max(min_max, samples, pyramid, start, first_block * block_size, min, max);
+	get_samples_min_max(min_max, samples, pyramid, last_block * block_size, end, min, max);
+}
+
+struct gral_layer {
+	int width;
+	int height;
+	cairo_surface_t *surface;
+	gboolean is_valid;
+};
+
+struct gral_layer *gral_layer_create(int width, int height) {
+	struct gral_layer *layer = g_slice_new(struct gral_layer);
+	layer->width = width;
+	layer->height = height;
+	layer->surface = NULL;
+	layer->is_valid = FALSE;
+	return layer;
+}
+
+void gral_layer_delete(struct gral_layer *layer) {
+	if (layer->surface) {
+		cairo_surface_destroy(layer->surface);
+	}
+	g_slice_free(struct gral_layer, layer);
+}
+
+void gral_layer_invalidate(struct gral_layer *layer) {
+	layer->is_valid = FALSE;
+}
+
+struct gral_draw_context *gral_draw_context_create(int width, int height) {
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	cairo_t *cr = cairo_create(surface);
+	cairo_surface_destroy(surface);
+	return (struct gral_draw_context *)cr;
+}
+
+void gral_draw_context_delete(struct gral_draw_context *draw_context) {
+	cairo_destroy((cairo_t *)draw_context);
+}
+
+void gral_draw_context_get_pixels(struct gral_draw_context *draw_context, void *data) {
+	cairo_surface_t *surface = cairo_get_target((cairo_t *)draw_context);
+	cairo_surface_flush(surface);
+	int width = cairo_image_surface_get_width(surface);
+	int height = cairo_image_surface_get_height(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	unsigned char const *surface_data = cairo_image_surface_get_data(surface);
+	unsigned char *destination = data;
+	count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	for (int y = 0; y < height; y++) {
+		guint32 const *source = (guint32 const *)(surface_data + y * stride);
+		for (int x = 0; x < width; x++) {
+			// premultiplied ARGB32 -> RGBA
+			guint32 a = source[x] >> 24;
+			guint32 r = source[x] >> 16 & 0xFF;
+			guint32 g = source[x] >> 8 & 0xFF;
+			guint32 b = source[x] & 0xFF;
+			if (a != 0 && a != 255) {
+				r = (r * 255 + a / 2) / a;
+				g = (g * 255 + a / 2) / a;
+				b = (b * 255 + a / 2) / a;
+			}
+			destination[0] = r;
+			destination[1] = g;
+			destination[2] = b;
+			destination[3] = a;
+			destination += 4;
+		}
+	}
+}
+
 void gral_draw_context_draw_image(struct gral_draw_context *draw_context, struct gral_image *image, float x, float y) {
-	int width = gdk_pixbuf_get_width((GdkPixbuf *)image);
-	int height = gdk_pixbuf_get_height((GdkPixbuf *)image);
+	int width = cairo_image_surface_get_width((cairo_surface_t *)image);
+	int height = cairo_image_surface_get_height((cairo_surface_t *)image);
+	count_draw_statistic(&draw_statistics.images, 1);
 	cairo_rectangle((cairo_t *)draw_context, x, y, width, height);
-	gdk_cairo_set_source_pixbuf((cairo_t *)draw_context, (GdkPixbuf *)image, x, y);
+	cairo_set_source_surface((cairo_t *)draw_context, (cairo_surface_t *)image, x, y);
 	cairo_fill((cairo_t *)draw_context);
 }
 
+void gral_draw_context_draw_image_scaled(struct gral_draw_context *draw_context, struct gral_image *image, float source_x, float source_y, float source_width, float source_height, float x, float y, float width, float height, int filter) {
+	cairo_t *cr = (cairo_t *)draw_context;
+	if (source_width <= 0.0f || source_height <= 0.0f || width <= 0.0f || height <= 0.0f) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	int level = 0;
+	if (filter == GRAL_IMAGE_FILTER_SMOOTH) {
+		// pick the mipmap level that is scaled down by less than a factor of two in device space
+		double device_scale_x, device_scale_y;
+		cairo_surface_get_device_scale(cairo_get_target(cr), &device_scale_x, &device_scale_y);
+		double scale_x = width / source_width, skew_x = 0.0;
+		cairo_user_to_device_distance(cr, &scale_x, &skew_x);
+		double skew_y = 0.0, scale_y = height / source_height;
+		cairo_user_to_device_distance(cr, &skew_y, &scale_y);
+		double scale = MAX(hypot(scale_x, skew_x) * device_scale_x, hypot(skew_y, scale_y) * device_scale_y);
+		while (scale <= 0.5 && level < MIPMAP_MAX_LEVELS) {
+			level++;
+			scale *= 2.0;
+		}
+	}
+	cairo_surface_t *surface = get_mipmap((cairo_surface_t *)image, &level);
+	// every pixel of a level covers exactly 2^level pixels of the image, only the last row and column can extend past it
+	double factor_x = ldexp(1.0, -level);
+	double factor_y = factor_x;
+	cairo_pattern_t *pattern = cairo_pattern_create_for_surface(surface);
+	cairo_matrix_t matrix;
+	cairo_matrix_init_scale(&matrix, source_width * factor_x / width, source_height * factor_y / height);
+	matrix.x0 = source_x * factor_x - x * matrix.xx;
+	matrix.y0 = source_y * factor_y - y * matrix.yy;
+	cairo_pattern_set_matrix(pattern, &matrix);
+	cairo_pattern_set_filter(pattern, filter == GRAL_IMAGE_FILTER_NEAREST ? CAIRO_FILTER_NEAREST : CAIRO_FILTER_BILINEAR);
+	cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+	cairo_rectangle(cr, x, y, width, height);
+	cairo_set_source(cr, pattern);
+	cairo_fill(cr);
+	cairo_pattern_destroy(pattern);
+	cairo_surface_destroy(surface);
+}
+
+static gboolean is_translation(cairo_t *cr) {
+	cairo_matrix_t matrix;
+	cairo_get_matrix(cr, &matrix);
+	return matrix.xx == 1.0 && matrix.yx == 0.0 && matrix.xy == 0.0 && matrix.yy == 1.0;
+}
+
+static cairo_pattern_t *create_padded_sprite_pattern(cairo_surface_t *surface, struct gral_sprite const *sprite) {
+	// a subsurface with EXTEND_PAD repeats the edge of the sprite instead of sampling its neighbors in the atlas
+	cairo_surface_t *subsurface = cairo_surface_create_for_rectangle(surface, sprite->source_x, sprite->source_y, sprite->width, sprite->height);
+	cairo_pattern_t *pattern = cairo_pattern_create_for_surface(subsurface);
+	cairo_surface_destroy(subsurface);
+	cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+	cairo_matrix_t matrix;
+	cairo_matrix_init_translate(&matrix, -sprite->x, -sprite->y);
+	cairo_pattern_set_matrix(pattern, &matrix);
+	return pattern;
+}
+
+void gral_draw_context_draw_sprites(struct gral_draw_context *draw_context, struct gral_image *image, struct gral_sprite const *sprites, int count, int tinted) {
+	// unscaled sprites at whole device pixels share a single pattern of which only the matrix changes from one sprite to the next
+	// anywhere else the filter samples between pixels, so those sprites get a padded pattern of their own
+	cairo_t *cr = (cairo_t *)draw_context;
+	if (count == 0) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.images, count);
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	gboolean is_aligned = is_translation(cr) && scale_x == 1.0 && scale_y == 1.0;
+	cairo_pattern_t *shared_pattern = cairo_pattern_create_for_surface((cairo_surface_t *)image);
+	for (int i = 0; i < count; i++) {
+		struct gral_sprite const *sprite = &sprites[i];
+		double device_x = sprite->x, device_y = sprite->y;
+		cairo_user_to_device(cr, &device_x, &device_y);
+		cairo_pattern_t *pattern;
+		if (is_aligned && device_x == floor(device_x) && device_y == floor(device_y) && sprite->source_x == floorf(sprite->source_x) && sprite->source_y == floorf(sprite->source_y)) {
+			pattern = cairo_pattern_reference(shared_pattern);
+			cairo_matrix_t matrix;
+			cairo_matrix_init_translate(&matrix, sprite->source_x - sprite->x, sprite->source_y - sprite->y);
+			cairo_pattern_set_matrix(pattern, &matrix);
+		}
+		else {
+			pattern = create_padded_sprite_pattern((cairo_surface_t *)image, sprite);
+		}
+		if (!tinted) {
+			cairo_set_source(cr, pattern);
+		}
+		cairo_rectangle(cr, sprite->x, sprite->y, sprite->width, sprite->height);
+		if (!tinted && sprite->alpha == 1.0f) {
+			cairo_fill(cr);
+			cairo_pattern_destroy(pattern);
+			continue;
+		}
+		// translucent and tinted sprites need a clip since neither cairo_paint_with_alpha nor cairo_mask are bounded by a path
+		cairo_save(cr);
+		cairo_clip(cr);
+		if (tinted) {
+			cairo_set_source_rgba(cr, sprite->red, sprite->green, sprite->blue, sprite->alpha);
+			cairo_mask(cr, pattern);
+		}
+		else {
+			cairo_paint_with_alpha(cr, sprite->alpha);
+		}
+		cairo_restore(cr);
+		cairo_pattern_destroy(pattern);
+	}
+	cairo_pattern_destroy(shared_pattern);
+}
+
+void gral_draw_context_draw_layer(struct gral_draw_context *draw_context, struct gral_layer *layer, float x, float y, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data) {
+	// the layer is an image surface so that it can be shared with the recordings of tiled rendering
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target((cairo_t *)draw_context), &scale_x, &scale_y);
+	if (layer->surface) {
+		double layer_scale_x, layer_scale_y;
+		cairo_surface_get_device_scale(layer->surface, &layer_scale_x, &layer_scale_y);
+		if (layer_scale_x != scale_x || layer_scale_y != scale_y) {
+			cairo_surface_destroy(layer->surface);
+			layer->surface = NULL;
+		}
+	}
+	if (layer->surface == NULL) {
+		layer->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, ceil(layer->width * scale_x), ceil(layer->height * scale_y));
+		cairo_surface_set_device_scale(layer->surface, scale_x, scale_y);
+		layer->is_valid = FALSE;
+	}
+	if (!layer->is_valid) {
+		cairo_t *cr = cairo_create(layer->surface);
+		cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+		cairo_paint(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+		callback((struct gral_draw_context *)cr, user_data);
+		cairo_destroy(cr);
+		layer->is_valid = TRUE;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	cairo_rectangle((cairo_t *)draw_context, x, y, layer->width, layer->height);
+	cairo_set_source_surface((cairo_t *)draw_context, layer->surface, x, y);
+	cairo_fill((cairo_t *)draw_context);
+}
+
+static void append_monospace_glyphs(cairo_glyph_t *glyphs, struct gral_text *text, MonospaceGlyphs *monospace_glyphs, float x, float y) {
+	char const *str = pango_layout_get_text(text->layout);
+	for (int i = 0; i < text->ascii_length; i++) {
+		glyphs[i].index = monospace_glyphs->glyphs[str[i] - 0x20];
+		glyphs[i].x = x + i * monospace_glyphs->advance;
+		glyphs[i].y = y;
+	}
+}
+
+static gboolean show_monospace_glyphs(cairo_t *cr, struct gral_text *text, float x, float y) {
+	MonospaceGlyphs *monospace_glyphs = get_text_monospace_glyphs(text);
+	if (monospace_glyphs == NULL || !is_translation(cr)) {
+		return FALSE;
+	}
+	// Cairo keeps the rasterized glyphs of a scaled font in its glyph cache, so the whole line is composited in a single call
+	cairo_glyph_t *glyphs = cairo_glyph_allocate(text->ascii_length);
+	append_monospace_glyphs(glyphs, text, monospace_glyphs, x, y);
+	cairo_set_scaled_font(cr, monospace_glyphs->scaled_font);
+	cairo_show_glyphs(cr, glyphs, text->ascii_length);
+	cairo_glyph_free(glyphs);
+	return TRUE;
+}
+
+typedef struct {
+	float margin;
+} Culling;
+static cairo_user_data_key_t culling_key;
+static void culling_free(void *data) {
+	g_slice_free(Culling, data);
+}
+
+static gboolean is_rectangle_visible(cairo_t *cr, double x1, double y1, double x2, double y2) {
+	// the clip extents are the bounding box of the clip in user space, so this is conservative under rotations
+	double clip_x1, clip_y1, clip_x2, clip_y2;
+	cairo_clip_extents(cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+	return x1 <= clip_x2 && x2 >= clip_x1 && y1 <= clip_y2 && y2 >= clip_y1;
+}
+
+static gboolean is_culled(cairo_t *cr, Culling const *culling, double x1, double y1, double x2, double y2) {
+	return !is_rectangle_visible(cr, x1 - culling->margin, y1 - culling->margin, x2 + culling->margin, y2 + culling->margin);
+}
+
+static gboolean is_text_culled(cairo_t *cr, struct gral_text *text, float x, float y) {
+	Culling const *culling = cairo_get_user_data(cr, &culling_key);
+	if (culling == NULL) {
+		return FALSE;
+	}
+	MonospaceGlyphs *monospace_glyphs = get_text_monospace_glyphs(text);
+	if (monospace_glyphs) {
+		// the font extents bound the glyphs vertically, one extra advance on each side covers glyphs that overhang their cell
+		double advance = monospace_glyphs->advance;
+		return is_culled(cr, culling, x - advance, y - monospace_glyphs->ascent, x + (text->ascii_length + 1) * advance, y + monospace_glyphs->descent);
+	}
+	PangoRectangle ink_rect;
+	pango_layout_line_get_pixel_extents(pango_layout_get_line_readonly(get_layout(text), 0), &ink_rect, NULL);
+	return is_culled(cr, culling, x + ink_rect.x, y + ink_rect.y, x + ink_rect.x + ink_rect.width, y + ink_rect.y + ink_rect.height);
+}
+
+static gboolean is_points_culled(cairo_t *cr, struct gral_point const *points, int count) {
+	Culling const *culling = cairo_get_user_data(cr, &culling_key);
+	if (culling == NULL) {
+		return FALSE;
+	}
+	float x1 = points[0].x, y1 = points[0].y, x2 = points[0].x, y2 = points[0].y;
+	for (int i = 1; i < count; i++) {
+		x1 = MIN(x1, points[i].x);
+		y1 = MIN(y1, points[i].y);
+		x2 = MAX(x2, points[i].x);
+		y2 = MAX(y2, points[i].y);
+	}
+	return is_culled(cr, culling, x1, y1, x2, y2);
+}
+
+int gral_draw_context_is_rectangle_visible(struct gral_draw_context *draw_context, float x, float y, float width, float height) {
+	return is_rectangle_visible((cairo_t *)draw_context, x, y, x + width, y + height);
+}
+
+void gral_draw_context_set_culling(struct gral_draw_context *draw_context, int enabled, float margin) {
+	if (enabled) {
+		Culling *culling = g_slice_new(Culling);
+		culling->margin = margin;
+		cairo_set_user_data((cairo_t *)draw_context, &culling_key, culling, &culling_free);
+	}
+	else {
+		cairo_set_user_data((cairo_t *)draw_context, &culling_key, NULL, NULL);
+	}
+}
+
 void gral_draw_context_draw_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y, float red, float green, float blue, float alpha) {
-	cairo_move_to((cairo_t *)draw_context, x, y);
+	if (is_text_culled((cairo_t *)draw_context, text, x, y)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.text_runs, 1);
 	cairo_set_source_rgba((cairo_t *)draw_context, red, green, blue, alpha);
-	PangoLayoutLine *line = pango_layout_get_line_readonly(PANGO_LAYOUT(text), 0);
+	if (show_monospace_glyphs((cairo_t *)draw_context, text, x, y)) {
+		return;
+	}
+	cairo_move_to((cairo_t *)draw_context, x, y);
+	PangoLayoutLine *line = pango_layout_get_line_readonly(get_layout(text), 0);
 	pango_cairo_show_layout_line((cairo_t *)draw_context, line);
 }
 
+typedef struct {
+	MonospaceGlyphs *monospace_glyphs;
+	struct gral_text_run const *run;
+} TextBatchEntry;
+
+static int compare_colors(struct gral_text_run const *a, struct gral_text_run const *b) {
+	if (a->red != b->red) return a->red < b->red ? -1 : 1;
+	if (a->green != b->green) return a->green < b->green ? -1 : 1;
+	if (a->blue != b->blue) return a->blue < b->blue ? -1 : 1;
+	if (a->alpha != b->alpha) return a->alpha < b->alpha ? -1 : 1;
+	return 0;
+}
+
+static int compare_text_batch_entries(void const *a, void const *b) {
+	TextBatchEntry const *entry_a = a;
+	TextBatchEntry const *entry_b = b;
+	if (entry_a->monospace_glyphs != entry_b->monospace_glyphs) {
+		return (guintptr)entry_a->monospace_glyphs < (guintptr)entry_b->monospace_glyphs ? -1 : 1;
+	}
+	int result = compare_colors(entry_a->run, entry_b->run);
+	if (result != 0) {
+		return result;
+	}
+	// keep the original order within a group
+	return entry_a->run < entry_b->run ? -1 : entry_a->run > entry_b->run;
+}
+
+void gral_draw_context_draw_text_batch(struct gral_draw_context *draw_context, struct gral_text_run const *runs, int count) {
+	// group the runs by font and color so that each group needs only one source change and one cairo_show_glyphs call
+	cairo_t *cr = (cairo_t *)draw_context;
+	gboolean use_monospace_glyphs = is_translation(cr);
+	TextBatchEntry *entries = g_new(TextBatchEntry, count);
+	int glyph_count = 0;
+	int entry_count = 0;
+	for (int i = 0; i < count; i++) {
+		if (is_text_culled(cr, runs[i].text, runs[i].x, runs[i].y)) {
+			continue;
+		}
+		TextBatchEntry *entry = &entries[entry_count++];
+		entry->monospace_glyphs = use_monospace_glyphs ? get_text_monospace_glyphs(runs[i].text) : NULL;
+		entry->run = &runs[i];
+		if (entry->monospace_glyphs) {
+			glyph_count += runs[i].text->ascii_length;
+		}
+	}
+	count = entry_count;
+	count_draw_statistic(&draw_statistics.text_runs, count);
+	qsort(entries, count, sizeof(TextBatchEntry), &compare_text_batch_entries);
+	cairo_glyph_t *glyphs = cairo_glyph_allocate(glyph_count);
+	int i = 0;
+	while (i < count) {
+		struct gral_text_run const *run = entries[i].run;
+		MonospaceGlyphs *monospace_glyphs = entries[i].monospace_glyphs;
+		cairo_set_source_rgba(cr, run->red, run->green, run->blue, run->alpha);
+		if (monospace_glyphs) {
+			int group_glyph_count = 0;
+			for (; i < count && entries[i].monospace_glyphs == monospace_glyphs && compare_colors(entries[i].run, run) == 0; i++) {
+				append_monospace_glyphs(glyphs + group_glyph_count, entries[i].run->text, monospace_glyphs, entries[i].run->x, entries[i].run->y);
+				group_glyph_count += entries[i].run->text->ascii_length;
+			}
+			cairo_set_scaled_font(cr, monospace_glyphs->scaled_font);
+			cairo_show_glyphs(cr, glyphs, group_glyph_count);
+		}
+		else {
+			for (; i < count && entries[i].monospace_glyphs == NULL && compare_colors(entries[i].run, run) == 0; i++) {
+				cairo_move_to(cr, entries[i].run->x, entries[i].run->y);
+				PangoLayoutLine *line = pango_layout_get_line_readonly(get_layout(entries[i].run->text), 0);
+				pango_cairo_show_layout_line(cr, line);
+			}
+		}
+	}
+	cairo_glyph_free(glyphs);
+	g_free(entries);
+}
+
 void gral_draw_context_add_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y) {
+	if (is_text_culled((cairo_t *)draw_context, text, x, y)) {
+		return;
+	}
 	cairo_move_to((cairo_t *)draw_context, x, y);
-	PangoLayoutLine *line = pango_layout_get_line_readonly(PANGO_LAYOUT(text), 0);
+	PangoLayoutLine *line = pango_layout_get_line_readonly(get_layout(text), 0);
 	pango_cairo_layout_line_path((cairo_t *)draw_context, line);
 }
 
+static gboolean get_path_bounds(cairo_path_t const *path, double *x1, double *y1, double *x2, double *y2) {
+	// the bounds of the control points contain the path
+	*x1 = G_MAXDOUBLE;
+	*y1 = G_MAXDOUBLE;
+	*x2 = -G_MAXDOUBLE;
+	*y2 = -G_MAXDOUBLE;
+	for (int i = 0; i < path->num_data; i += path->data[i].header.length) {
+		for (int j = 1; j < path->data[i].header.length; j++) {
+			cairo_path_data_t const *point = &path->data[i + j];
+			*x1 = MIN(*x1, point->point.x);
+			*y1 = MIN(*y1, point->point.y);
+			*x2 = MAX(*x2, point->point.x);
+			*y2 = MAX(*y2, point->point.y);
+		}
+	}
+	return *x1 <= *x2;
+}
+
+void gral_draw_context_add_path(struct gral_draw_context *draw_context, struct gral_path *path) {
+	// the path data is stored in the same layout that cairo_copy_path returns, so it is appended without being rebuilt
+	cairo_path_t cairo_path;
+	cairo_path.status = CAIRO_STATUS_SUCCESS;
+	cairo_path.data = (cairo_path_data_t *)path->data->data;
+	cairo_path.num_data = path->data->len;
+	Culling const *culling = cairo_get_user_data((cairo_t *)draw_context, &culling_key);
+	double x1, y1, x2, y2;
+	if (culling && get_path_bounds(&cairo_path, &x1, &y1, &x2, &y2) && is_culled((cairo_t *)draw_context, culling, x1, y1, x2, y2)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	cairo_append_path((cairo_t *)draw_context, &cairo_path);
+}
+
 void gral_draw_context_close_path(struct gral_draw_context *draw_context) {
 	cairo_close_path((cairo_t *)draw_context);
 }
 
 void gral_draw_context_move_to(struct gral_draw_context *draw_context, float x, float y) {
+	count_draw_statistic(&draw_statistics.paths, 1);
 	cairo_move_to((cairo_t *)draw_context, x, y);
 }
 
@@ -248,23 +1517,427 @@ void gral_draw_context_curve_to(struct gral_draw_context *draw_context, float x1
 	cairo_curve_to((cairo_t *)draw_context, x1, y1, x2, y2, x, y);
 }
 
+static void append_points(cairo_path_data_t *data, cairo_path_data_type_t type, struct gral_point const *points, int count) {
+	data[0].header.type = type;
+	data[0].header.length = count + 1;
+	for (int i = 0; i < count; i++) {
+		data[i + 1].point.x = points[i].x;
+		data[i + 1].point.y = points[i].y;
+	}
+}
+
+static void append_path_data(cairo_t *cr, cairo_path_data_t *data, int count, int closed) {
+	if (closed) {
+		data[count].header.type = CAIRO_PATH_CLOSE_PATH;
+		data[count].header.length = 1;
+		count++;
+	}
+	cairo_path_t path;
+	path.status = CAIRO_STATUS_SUCCESS;
+	path.data = data;
+	path.num_data = count;
+	cairo_append_path(cr, &path);
+}
+
+void gral_draw_context_add_polyline(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed) {
+	// build the whole polyline as one cairo_path_t so that it is appended in a single call
+	if (count < 1 || is_points_culled((cairo_t *)draw_context, points, count)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	cairo_path_data_t *data = g_new(cairo_path_data_t, count * 2 + 1);
+	append_points(data, CAIRO_PATH_MOVE_TO, points, 1);
+	for (int i = 1; i < count; i++) {
+		append_points(data + i * 2, CAIRO_PATH_LINE_TO, points + i, 1);
+	}
+	append_path_data((cairo_t *)draw_context, data, count * 2, closed);
+	g_free(data);
+}
+
+void gral_draw_context_add_curves(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed) {
+	// the first point is the start point, followed by three points for each curve
+	if (count < 1 || is_points_culled((cairo_t *)draw_context, points, count)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	int curve_count = (count - 1) / 3;
+	cairo_path_data_t *data = g_new(cairo_path_data_t, 2 + curve_count * 4 + 1);
+	append_points(data, CAIRO_PATH_MOVE_TO, points, 1);
+	for (int i = 0; i < curve_count; i++) {
+		append_points(data + 2 + i * 4, CAIRO_PATH_CURVE_TO, points + 1 + i * 3, 3);
+	}
+	append_path_data((cairo_t *)draw_context, data, 2 + curve_count * 4, closed);
+	g_free(data);
+}
+
+static void append_sample_point(GArray *data, double x, double y) {
+	cairo_path_data_t header;
+	header.header.type = data->len == 0 ? CAIRO_PATH_MOVE_TO : CAIRO_PATH_LINE_TO;
+	header.header.length = 2;
+	g_array_append_val(data, header);
+	cairo_path_data_t point;
+	point.point.x = x;
+	point.point.y = y;
+	g_array_append_val(data, point);
+}
+
+void gral_draw_context_add_samples(struct gral_draw_context *draw_context, float const *samples, int count, struct gral_sample_pyramid *pyramid, float x, float y, float x_scale, float y_scale) {
+	// sample i is located at (x + i * x_scale, y + samples[i] * y_scale)
+	cairo_t *cr = (cairo_t *)draw_context;
+	if (count < 1) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	int start = 0;
+	int end = count;
+	// the device scale is not part of the matrix, but the pixel columns are in device pixels
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	double dx = x_scale, dy = 0.0;
+	cairo_user_to_device_distance(cr, &dx, &dy);
+	dx *= scale_x;
+	double vertical_x = 0.0, vertical_y = 1.0;
+	cairo_user_to_device_distance(cr, &vertical_x, &vertical_y);
+	gboolean is_axis_aligned = x_scale > 0.0f && dx > 0.0 && dy == 0.0 && vertical_x == 0.0;
+	if (x_scale > 0.0f) {
+		// skip the samples outside of the clip
+		double clip_x1, clip_y1, clip_x2, clip_y2;
+		cairo_clip_extents(cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+		start = (int)CLAMP(floor((clip_x1 - x) / x_scale) - 1.0, 0.0, count - 1.0);
+		end = (int)CLAMP(ceil((clip_x2 - x) / x_scale) + 2.0, start + 1.0, (double)count);
+	}
+	GArray *data = g_array_new(FALSE, FALSE, sizeof(cairo_path_data_t));
+	if (!is_axis_aligned || dx > 0.25) {
+		for (int i = start; i < end; i++) {
+			append_sample_point(data, x + (double)i * x_scale, y + samples[i] * y_scale);
+		}
+	}
+	else {
+		// reduce the samples of every device pixel column to its first, minimum, maximum and last value, which rasterizes identically
+		MinMaxFunction min_max = get_min_max_function();
+		double device_x = x, device_y = y;
+		cairo_user_to_device(cr, &device_x, &device_y);
+		device_x *= scale_x;
+		int i = start;
+		while (i < end) {
+			double column = floor(device_x + i * dx);
+			int next = (int)MIN(ceil((column + 1.0 - device_x) / dx), (double)end);
+			if (next <= i) {
+				next = i + 1;
+			}
+			float min = samples[i];
+			float max = samples[i];
+			get_samples_min_max(min_max, samples, pyramid, i, next, &min, &max);
+			double column_x = x + (double)i * x_scale;
+			append_sample_point(data, column_x, y + samples[i] * y_scale);
+			append_sample_point(data, column_x, y + min * y_scale);
+			append_sample_point(data, column_x, y + max * y_scale);
+			append_sample_point(data, x + (double)(next - 1) * x_scale, y + samples[next - 1] * y_scale);
+			i = next;
+		}
+	}
+	cairo_path_t path;
+	path.status = CAIRO_STATUS_SUCCESS;
+	path.data = (cairo_path_data_t *)data->data;
+	path.num_data = data->len;
+	cairo_append_path(cr, &path);
+	g_array_free(data, TRUE);
+}
+
 void gral_draw_context_fill(struct gral_draw_context *draw_context, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.fills, 1);
 	cairo_set_source_rgba((cairo_t *)draw_context, red, green, blue, alpha);
 	cairo_fill((cairo_t *)draw_context);
 }
 
-void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
-	cairo_pattern_t *gradient = cairo_pattern_create_linear(start_x, start_y, end_x, end_y);
-	int i;
-	for (i = 0; i < count; i++) {
-		cairo_pattern_add_color_stop_rgba(gradient, stops[i].position, stops[i].red, stops[i].green, stops[i].blue, stops[i].alpha);
+static gboolean is_integral(double value) {
+	return value == floor(value);
+}
+
+static gboolean is_pixel_aligned(cairo_t *cr) {
+	// whole user units only land on whole device pixels if the device scale is integral as well
+	cairo_matrix_t matrix;
+	cairo_get_matrix(cr, &matrix);
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	return matrix.xx == 1.0 && matrix.yx == 0.0 && matrix.xy == 0.0 && matrix.yy == 1.0 && is_integral(matrix.x0) && is_integral(matrix.y0) && is_integral(scale_x) && is_integral(scale_y);
+}
+
+static cairo_path_t *take_current_path(cairo_t *cr) {
+	// the rectangle functions fill only the rectangles and leave the current path as it was
+	if (!cairo_has_current_point(cr)) {
+		return NULL;
+	}
+	cairo_path_t *path = cairo_copy_path(cr);
+	cairo_new_path(cr);
+	return path;
+}
+
+static void restore_current_path(cairo_t *cr, cairo_path_t *path) {
+	if (path) {
+		cairo_append_path(cr, path);
+		cairo_path_destroy(path);
+	}
+}
+
+static gboolean is_rectangle_integral(float x, float y, float width, float height) {
+	return is_integral(x) && is_integral(y) && is_integral(width) && is_integral(height);
+}
+
+void gral_draw_context_fill_rectangles(struct gral_draw_context *draw_context, struct gral_rectangle const *rectangles, int count, float red, float green, float blue, float alpha) {
+	cairo_t *cr = (cairo_t *)draw_context;
+	cairo_path_t *path = take_current_path(cr);
+	gboolean is_aligned = is_pixel_aligned(cr);
+	for (int i = 0; i < count; i++) {
+		is_aligned = is_aligned && is_rectangle_integral(rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height);
+		cairo_rectangle(cr, rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height);
+	}
+	count_draw_statistic(&draw_statistics.fills, 1);
+	// pixel-aligned boxes are filled without antialiasing, which lets Cairo take its box compositing fast path
+	cairo_antialias_t antialias = cairo_get_antialias(cr);
+	if (is_aligned) {
+		cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+	}
+	cairo_set_source_rgba(cr, red, green, blue, alpha);
+	cairo_fill(cr);
+	cairo_set_antialias(cr, antialias);
+	restore_current_path(cr, path);
+}
+
+static guint32 pack_color_component(float value) {
+	return (guint32)(CLAMP(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+static gboolean fill_colored_rectangles_raster(cairo_t *cr, struct gral_colored_rectangle const *rectangles, int count) {
+	// opaque pixel-aligned rectangles are written directly into an image that is composited once
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	if (!is_pixel_aligned(cr)) {
+		return FALSE;
+	}
+	int x0 = G_MAXINT, y0 = G_MAXINT, x1 = G_MININT, y1 = G_MININT;
+	double area = 0.0;
+	for (int i = 0; i < count; i++) {
+		struct gral_colored_rectangle const *rectangle = &rectangles[i];
+		if (rectangle->alpha != 1.0f || !is_rectangle_integral(rectangle->x, rectangle->y, rectangle->width, rectangle->height) || rectangle->width < 0.0f || rectangle->height < 0.0f) {
+			return FALSE;
+		}
+		x0 = MIN(x0, (int)rectangle->x);
+		y0 = MIN(y0, (int)rectangle->y);
+		x1 = MAX(x1, (int)(rectangle->x + rectangle->width));
+		y1 = MAX(y1, (int)(rectangle->y + rectangle->height));
+		area += (double)rectangle->width * rectangle->height;
+	}
+	if ((double)(x1 - x0) * (y1 - y0) > 2.0 * area) {
+		// too sparse to be worth an intermediate image
+		return FALSE;
+	}
+	// only the visible part of the rectangles needs an image
+	double clip_x0, clip_y0, clip_x1, clip_y1;
+	cairo_clip_extents(cr, &clip_x0, &clip_y0, &clip_x1, &clip_y1);
+	x0 = MAX(x0, (int)MAX(floor(clip_x0), (double)G_MININT));
+	y0 = MAX(y0, (int)MAX(floor(clip_y0), (double)G_MININT));
+	x1 = MIN(x1, (int)MIN(ceil(clip_x1), (double)G_MAXINT));
+	y1 = MIN(y1, (int)MIN(ceil(clip_y1), (double)G_MAXINT));
+	if (x1 <= x0 || y1 <= y0) {
+		return TRUE;
+	}
+	int scale = (int)scale_x;
+	int vertical_scale = (int)scale_y;
+	// Cairo image surfaces are limited to 32767 pixels in each direction
+	if ((double)(x1 - x0) * scale > 32767.0 || (double)(y1 - y0) * vertical_scale > 32767.0) {
+		return FALSE;
+	}
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (x1 - x0) * scale, (y1 - y0) * vertical_scale);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surface);
+		return FALSE;
+	}
+	cairo_surface_set_device_scale(surface, scale_x, scale_y);
+	unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	int surface_width = cairo_image_surface_get_width(surface);
+	int surface_height = cairo_image_surface_get_height(surface);
+	for (int i = 0; i < count; i++) {
+		struct gral_colored_rectangle const *rectangle = &rectangles[i];
+		guint32 pixel = 0xFF000000 | pack_color_component(rectangle->red) << 16 | pack_color_component(rectangle->green) << 8 | pack_color_component(rectangle->blue);
+		int left = MAX(((int)rectangle->x - x0) * scale, 0);
+		int right = MIN(((int)(rectangle->x + rectangle->width) - x0) * scale, surface_width);
+		int top = MAX(((int)rectangle->y - y0) * vertical_scale, 0);
+		int bottom = MIN(((int)(rectangle->y + rectangle->height) - y0) * vertical_scale, surface_height);
+		for (int y = top; y < bottom; y++) {
+			guint32 *row = (guint32 *)(data + y * stride);
+			for (int x = left; x < right; x++) {
+				row[x] = pixel;
+			}
+		}
+	}
+	cairo_surface_mark_dirty(surface);
+	cairo_set_source_surface(cr, surface, x0, y0);
+	cairo_rectangle(cr, x0, y0, x1 - x0, y1 - y0);
+	cairo_fill(cr);
+	cairo_surface_destroy(surface);
+	return TRUE;
+}
+
+void gral_draw_context_fill_colored_rectangles(struct gral_draw_context *draw_context, struct gral_colored_rectangle const *rectangles, int count) {
+	cairo_t *cr = (cairo_t *)draw_context;
+	if (count == 0) {
+		return;
 	}
-	cairo_set_source((cairo_t *)draw_context, gradient);
+	count_draw_statistic(&draw_statistics.fills, 1);
+	cairo_path_t *path = take_current_path(cr);
+	if (!fill_colored_rectangles_raster(cr, rectangles, count)) {
+		// fill runs of rectangles with the same color together
+		for (int i = 0; i < count; i++) {
+			struct gral_colored_rectangle const *rectangle = &rectangles[i];
+			cairo_rectangle(cr, rectangle->x, rectangle->y, rectangle->width, rectangle->height);
+			struct gral_colored_rectangle const *next = i + 1 < count ? &rectangles[i + 1] : NULL;
+			if (next == NULL || next->red != rectangle->red || next->green != rectangle->green || next->blue != rectangle->blue || next->alpha != rectangle->alpha) {
+				cairo_set_source_rgba(cr, rectangle->red, rectangle->green, rectangle->blue, rectangle->alpha);
+				cairo_fill(cr);
+			}
+		}
+	}
+	restore_current_path(cr, path);
+}
+
+#define PATH_MASK_SUBPIXELS 4
+
+static cairo_surface_t *create_path_mask(cairo_path_t const *path, int width, int height, double x, double y, double scale_x, double scale_y) {
+	// the mask is rasterized in device pixels and gets the device scale afterwards so that it can be composited in user space
+	cairo_surface_t *mask = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height);
+	cairo_t *cr = cairo_create(mask);
+	cairo_translate(cr, x, y);
+	cairo_scale(cr, scale_x, scale_y);
+	cairo_append_path(cr, path);
+	cairo_fill(cr);
+	cairo_destroy(cr);
+	cairo_surface_set_device_scale(mask, scale_x, scale_y);
+	return mask;
+}
+
+void gral_draw_context_fill_path_instances(struct gral_draw_context *draw_context, struct gral_path *path, struct gral_path_instance const *instances, int count) {
+	cairo_t *cr = (cairo_t *)draw_context;
+	cairo_path_t cairo_path;
+	cairo_path.status = CAIRO_STATUS_SUCCESS;
+	cairo_path.data = (cairo_path_data_t *)path->data->data;
+	cairo_path.num_data = path->data->len;
+	if (count == 0 || cairo_path.num_data == 0) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	count_draw_statistic(&draw_statistics.fills, count);
+	if (!is_translation(cr)) {
+		for (int i = 0; i < count; i++) {
+			cairo_translate(cr, instances[i].x, instances[i].y);
+			cairo_append_path(cr, &cairo_path);
+			cairo_translate(cr, -instances[i].x, -instances[i].y);
+			cairo_set_source_rgba(cr, instances[i].red, instances[i].green, instances[i].blue, instances[i].alpha);
+			cairo_fill(cr);
+		}
+		return;
+	}
+	double path_x1, path_y1, path_x2, path_y2;
+	if (!get_path_bounds(&cairo_path, &path_x1, &path_y1, &path_x2, &path_y2)) {
+		return;
+	}
+	// rasterize the path once for every subpixel offset that is used and composite the masks at whole device pixels
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	int origin_x = (int)floor(path_x1 * scale_x) - 1;
+	int origin_y = (int)floor(path_y1 * scale_y) - 1;
+	int width = (int)ceil(path_x2 * scale_x) - origin_x + 2;
+	int height = (int)ceil(path_y2 * scale_y) - origin_y + 2;
+	cairo_matrix_t matrix;
+	cairo_get_matrix(cr, &matrix);
+	double clip_x1, clip_y1, clip_x2, clip_y2;
+	cairo_clip_extents(cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+	cairo_surface_t *masks[PATH_MASK_SUBPIXELS * PATH_MASK_SUBPIXELS] = {NULL};
+	for (int i = 0; i < count; i++) {
+		struct gral_path_instance const *instance = &instances[i];
+		if (instance->x + path_x1 - 1.0 > clip_x2 || instance->x + path_x2 + 1.0 < clip_x1 || instance->y + path_y1 - 1.0 > clip_y2 || instance->y + path_y2 + 1.0 < clip_y1) {
+			continue;
+		}
+		double instance_x = (instance->x + matrix.x0) * scale_x;
+		double instance_y = (instance->y + matrix.y0) * scale_y;
+		double device_x = floor(instance_x);
+		double device_y = floor(instance_y);
+		int subpixel_x = (int)((instance_x - device_x) * PATH_MASK_SUBPIXELS + 0.5);
+		int subpixel_y = (int)((instance_y - device_y) * PATH_MASK_SUBPIXELS + 0.5);
+		if (subpixel_x == PATH_MASK_SUBPIXELS) {
+			device_x += 1.0;
+			subpixel_x = 0;
+		}
+		if (subpixel_y == PATH_MASK_SUBPIXELS) {
+			device_y += 1.0;
+			subpixel_y = 0;
+		}
+		cairo_surface_t **mask = &masks[subpixel_y * PATH_MASK_SUBPIXELS + subpixel_x];
+		if (*mask == NULL) {
+			*mask = create_path_mask(&cairo_path, width, height, (double)subpixel_x / PATH_MASK_SUBPIXELS - origin_x, (double)subpixel_y / PATH_MASK_SUBPIXELS - origin_y, scale_x, scale_y);
+		}
+		cairo_set_source_rgba(cr, instance->red, instance->green, instance->blue, instance->alpha);
+		cairo_mask_surface(cr, *mask, (device_x + origin_x) / scale_x - matrix.x0, (device_y + origin_y) / scale_y - matrix.y0);
+	}
+	for (int i = 0; i < PATH_MASK_SUBPIXELS * PATH_MASK_SUBPIXELS; i++) {
+		if (masks[i]) {
+			cairo_surface_destroy(masks[i]);
+		}
+	}
+}
+
+#define GRADIENT_CACHE_SIZE 64
+
+typedef struct {
+	float coordinates[4];
+	struct gral_gradient_stop *stops;
+	int count;
+	cairo_pattern_t *pattern;
+} GradientCacheEntry;
+static GradientCacheEntry gradient_cache[GRADIENT_CACHE_SIZE];
+
+static guint32 hash_bytes(guint32 hash, void const *data, size_t size) {
+	// FNV-1a
+	unsigned char const *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static cairo_pattern_t *get_linear_gradient(float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
+	// gradients that are drawn every frame are looked up in a small direct-mapped cache instead of being rebuilt
+	float coordinates[4] = {start_x, start_y, end_x, end_y};
+	guint32 hash = hash_bytes(2166136261u, coordinates, sizeof(coordinates));
+	hash = hash_bytes(hash, stops, count * sizeof(struct gral_gradient_stop));
+	GradientCacheEntry *entry = &gradient_cache[hash % GRADIENT_CACHE_SIZE];
+	if (entry->pattern && entry->count == count && memcmp(entry->coordinates, coordinates, sizeof(coordinates)) == 0 && memcmp(entry->stops, stops, count * sizeof(struct gral_gradient_stop)) == 0) {
+		return entry->pattern;
+	}
+	if (entry->pattern) {
+		cairo_pattern_destroy(entry->pattern);
+		g_free(entry->stops);
+	}
+	memcpy(entry->coordinates, coordinates, sizeof(coordinates));
+	entry->stops = g_new(struct gral_gradient_stop, count);
+	memcpy(entry->stops, stops, count * sizeof(struct gral_gradient_stop));
+	entry->count = count;
+	entry->pattern = cairo_pattern_create_linear(start_x, start_y, end_x, end_y);
+	for (int i = 0; i < count; i++) {
+		cairo_pattern_add_color_stop_rgba(entry->pattern, stops[i].position, stops[i].red, stops[i].green, stops[i].blue, stops[i].alpha);
+	}
+	return entry->pattern;
+}
+
+void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
+	count_draw_statistic(&draw_statistics.fills, 1);
+	cairo_set_source((cairo_t *)draw_context, get_linear_gradient(start_x, start_y, end_x, end_y, stops, count));
 	cairo_fill((cairo_t *)draw_context);
-	cairo_pattern_destroy(gradient);
 }
 
 void gral_draw_context_stroke(struct gral_draw_context *draw_context, float line_width, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.strokes, 1);
 	cairo_set_line_width((cairo_t *)draw_context, line_width);
 	cairo_set_line_cap((cairo_t *)draw_context, CAIRO_LINE_CAP_ROUND);
 	cairo_set_line_join((cairo_t *)draw_context, CAIRO_LINE_JOIN_ROUND);
@@ -273,17 +1946,12 @@ void gral_draw_context_stroke(struct gral_draw_context *draw_context, float line
 }
 
 void gral_draw_context_stroke_linear_gradient(struct gral_draw_context *draw_context, float line_width, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
+	count_draw_statistic(&draw_statistics.strokes, 1);
 	cairo_set_line_width((cairo_t *)draw_context, line_width);
 	cairo_set_line_cap((cairo_t *)draw_context, CAIRO_LINE_CAP_ROUND);
 	cairo_set_line_join((cairo_t *)draw_context, CAIRO_LINE_JOIN_ROUND);
-	cairo_pattern_t *gradient = cairo_pattern_create_linear(start_x, start_y, end_x, end_y);
-	int i;
-	for (i = 0; i < count; i++) {
-		cairo_pattern_add_color_stop_rgba(gradient, stops[i].position, stops[i].red, stops[i].green, stops[i].blue, stops[i].alpha);
-	}
-	cairo_set_source((cairo_t *)draw_context, gradient);
+	cairo_set_source((cairo_t *)draw_context, get_linear_gradient(start_x, start_y, end_x, end_y, stops, count));
 	cairo_stroke((cairo_t *)draw_context);
-	cairo_pattern_destroy(gradient);
 }
 
 void gral_draw_context_draw_clipped(struct gral_draw_context *draw_context, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data) {
@@ -326,6 +1994,11 @@ struct _GralWindow {
 	gboolean is_pointer_locked;
 	gint locked_pointer_x, locked_pointer_y;
 	guint last_key;
+	int redraw_merge_threshold;
+	int render_threads;
+	GThreadPool *tile_pool;
+	cairo_surface_t *backing;
+	cairo_region_t *backing_damage;
 };
 G_DEFINE_TYPE(GralWindow, gral_window, GTK_TYPE_APPLICATION_WINDOW)
 
@@ -336,6 +2009,13 @@ static gboolean gral_window_delete_event(GtkWidget *widget, GdkEventAny *event)
 static void gral_window_finalize(GObject *object) {
 	GralWindow *window = GRAL_WINDOW(object);
 	window->interface->destroy(window->user_data);
+	if (window->tile_pool) {
+		g_thread_pool_free(window->tile_pool, FALSE, TRUE);
+	}
+	if (window->backing) {
+		cairo_surface_destroy(window->backing);
+		cairo_region_destroy(window->backing_damage);
+	}
 	G_OBJECT_CLASS(gral_window_parent_class)->finalize(object);
 }
 static void gral_window_activate_menu_item(GSimpleAction *action, GVariant *parameter, gpointer user_data) {
@@ -386,11 +2066,246 @@ static void gral_widget_unrealize(GtkWidget *widget) {
 	gdk_window_destroy(window);
 	gtk_widget_set_realized(widget, FALSE);
 }
+static int get_rectangle_area(GdkRectangle const *rectangle) {
+	return rectangle->width * rectangle->height;
+}
+static int merge_rectangles(GdkRectangle *rectangles, int count, int threshold) {
+	// merge two rectangles if they overlap or if their union repaints at most threshold additional pixels
+	gboolean has_merged = TRUE;
+	while (has_merged) {
+		has_merged = FALSE;
+		for (int i = 0; i < count; i++) {
+			for (int j = i + 1; j < count; j++) {
+				GdkRectangle union_rectangle;
+				gdk_rectangle_union(&rectangles[i], &rectangles[j], &union_rectangle);
+				if (gdk_rectangle_intersect(&rectangles[i], &rectangles[j], NULL) || get_rectangle_area(&union_rectangle) - get_rectangle_area(&rectangles[i]) - get_rectangle_area(&rectangles[j]) <= threshold) {
+					rectangles[i] = union_rectangle;
+					rectangles[j] = rectangles[count - 1];
+					count--;
+					j = i;
+					has_merged = TRUE;
+				}
+			}
+		}
+	}
+	return count;
+}
+static void draw_dirty_rectangles(GralWindow *window, cairo_t *cr) {
+	// the default threshold merges everything, which draws the bounding box of the dirty region once
+	cairo_rectangle_list_t *rectangle_list = window->redraw_merge_threshold == G_MAXINT ? NULL : cairo_copy_clip_rectangle_list(cr);
+	if (rectangle_list == NULL || rectangle_list->status != CAIRO_STATUS_SUCCESS || rectangle_list->num_rectangles <= 1) {
+		if (rectangle_list) {
+			cairo_rectangle_list_destroy(rectangle_list);
+		}
+		GdkRectangle clip_rectangle;
+		gdk_cairo_get_clip_rectangle(cr, &clip_rectangle);
+		window->interface->draw((struct gral_draw_context *)cr, clip_rectangle.x, clip_rectangle.y, clip_rectangle.width, clip_rectangle.height, window->user_data);
+		return;
+	}
+	// call draw once per disjoint dirty rectangle instead of once for their bounding box
+	GdkRectangle *rectangles = g_new(GdkRectangle, rectangle_list->num_rectangles);
+	for (int i = 0; i < rectangle_list->num_rectangles; i++) {
+		cairo_rectangle_t const *rectangle = &rectangle_list->rectangles[i];
+		rectangles[i].x = floor(rectangle->x);
+		rectangles[i].y = floor(rectangle->y);
+		rectangles[i].width = ceil(rectangle->x + rectangle->width) - rectangles[i].x;
+		rectangles[i].height = ceil(rectangle->y + rectangle->height) - rectangles[i].y;
+	}
+	int count = merge_rectangles(rectangles, rectangle_list->num_rectangles, window->redraw_merge_threshold);
+	cairo_rectangle_list_destroy(rectangle_list);
+	for (int i = 0; i < count; i++) {
+		cairo_save(cr);
+		cairo_rectangle(cr, rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height);
+		cairo_clip(cr);
+		window->interface->draw((struct gral_draw_context *)cr, rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height, window->user_data);
+		cairo_restore(cr);
+	}
+	g_free(rectangles);
+}
+#define TILE_SIZE 256
+typedef struct {
+	GMutex mutex;
+	GCond cond;
+	int remaining;
+} TileBatch;
+typedef struct {
+	cairo_surface_t *recording;
+	int x, y, width, height;
+	double scale_x, scale_y;
+	cairo_surface_t *surface;
+	TileBatch *batch;
+} Tile;
+static void render_tile(gpointer data, gpointer user_data) {
+	Tile *tile = data;
+	tile->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, ceil(tile->width * tile->scale_x), ceil(tile->height * tile->scale_y));
+	cairo_surface_set_device_scale(tile->surface, tile->scale_x, tile->scale_y);
+	cairo_t *cr = cairo_create(tile->surface);
+	cairo_set_source_surface(cr, tile->recording, -tile->x, -tile->y);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	g_mutex_lock(&tile->batch->mutex);
+	tile->batch->remaining--;
+	if (tile->batch->remaining == 0) {
+		g_cond_signal(&tile->batch->cond);
+	}
+	g_mutex_unlock(&tile->batch->mutex);
+}
+static void draw_tiled(GralWindow *window, cairo_t *cr) {
+	// record the frame once on the main thread, rasterize it tile by tile on the worker threads and composite the tiles
+	// the tiles are rendered with an alpha channel, so text is drawn with grayscale instead of subpixel antialiasing
+	GdkRectangle extents;
+	if (!gdk_cairo_get_clip_rectangle(cr, &extents)) {
+		return;
+	}
+	cairo_rectangle_list_t *rectangle_list = cairo_copy_clip_rectangle_list(cr);
+	cairo_region_t *dirty_region;
+	if (rectangle_list->status == CAIRO_STATUS_SUCCESS) {
+		dirty_region = cairo_region_create();
+		for (int i = 0; i < rectangle_list->num_rectangles; i++) {
+			cairo_rectangle_t const *rectangle = &rectangle_list->rectangles[i];
+			cairo_rectangle_int_t dirty_rectangle;
+			dirty_rectangle.x = floor(rectangle->x);
+			dirty_rectangle.y = floor(rectangle->y);
+			dirty_rectangle.width = ceil(rectangle->x + rectangle->width) - dirty_rectangle.x;
+			dirty_rectangle.height = ceil(rectangle->y + rectangle->height) - dirty_rectangle.y;
+			cairo_region_union_rectangle(dirty_region, &dirty_rectangle);
+		}
+	}
+	else {
+		dirty_region = cairo_region_create_rectangle(&extents);
+	}
+	cairo_rectangle_t frame_extents = {extents.x, extents.y, extents.width, extents.height};
+	cairo_surface_t *frame = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &frame_extents);
+	cairo_t *frame_cr = cairo_create(frame);
+	if (rectangle_list->status == CAIRO_STATUS_SUCCESS) {
+		for (int i = 0; i < rectangle_list->num_rectangles; i++) {
+			cairo_rectangle_t const *rectangle = &rectangle_list->rectangles[i];
+			cairo_rectangle(frame_cr, rectangle->x, rectangle->y, rectangle->width, rectangle->height);
+		}
+		cairo_clip(frame_cr);
+	}
+	cairo_rectangle_list_destroy(rectangle_list);
+	draw_dirty_rectangles(window, frame_cr);
+	cairo_destroy(frame_cr);
+	double scale_x, scale_y;
+	cairo_surface_get_device_scale(cairo_get_target(cr), &scale_x, &scale_y);
+	int columns = (extents.width + TILE_SIZE - 1) / TILE_SIZE;
+	int rows = (extents.height + TILE_SIZE - 1) / TILE_SIZE;
+	Tile *tiles = g_new(Tile, columns * rows);
+	int count = 0;
+	TileBatch batch;
+	g_mutex_init(&batch.mutex);
+	g_cond_init(&batch.cond);
+	for (int i = 0; i < columns * rows; i++) {
+		Tile *tile = &tiles[count];
+		tile->x = extents.x + (i % columns) * TILE_SIZE;
+		tile->y = extents.y + (i / columns) * TILE_SIZE;
+		tile->width = MIN(TILE_SIZE, extents.x + extents.width - tile->x);
+		tile->height = MIN(TILE_SIZE, extents.y + extents.height - tile->y);
+		cairo_rectangle_int_t tile_rectangle = {tile->x, tile->y, tile->width, tile->height};
+		if (cairo_region_contains_rectangle(dirty_region, &tile_rectangle) == CAIRO_REGION_OVERLAP_OUT) {
+			continue;
+		}
+		tile->scale_x = scale_x;
+		tile->scale_y = scale_y;
+		tile->batch = &batch;
+		// replaying a recording surface modifies it, so every tile gets its own copy of the frame restricted to the tile
+		cairo_rectangle_t recording_extents = {tile->x, tile->y, tile->width, tile->height};
+		tile->recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, &recording_extents);
+		cairo_t *recording_cr = cairo_create(tile->recording);
+		cairo_rectangle(recording_cr, tile->x, tile->y, tile->width, tile->height);
+		cairo_clip(recording_cr);
+		cairo_set_source_surface(recording_cr, frame, 0.0, 0.0);
+		cairo_paint(recording_cr);
+		cairo_destroy(recording_cr);
+		count++;
+	}
+	cairo_region_destroy(dirty_region);
+	cairo_surface_destroy(frame);
+	batch.remaining = count;
+	if (window->tile_pool == NULL) {
+		window->tile_pool = g_thread_pool_new(&render_tile, NULL, window->render_threads, FALSE, NULL);
+	}
+	for (int i = 0; i < count; i++) {
+		g_thread_pool_push(window->tile_pool, &tiles[i], NULL);
+	}
+	g_mutex_lock(&batch.mutex);
+	while (batch.remaining > 0) {
+		g_cond_wait(&batch.cond, &batch.mutex);
+	}
+	g_mutex_unlock(&batch.mutex);
+	for (int i = 0; i < count; i++) {
+		Tile *tile = &tiles[i];
+		cairo_set_source_surface(cr, tile->surface, tile->x, tile->y);
+		cairo_rectangle(cr, tile->x, tile->y, tile->width, tile->height);
+		cairo_fill(cr);
+		cairo_surface_destroy(tile->surface);
+		cairo_surface_destroy(tile->recording);
+	}
+	g_mutex_clear(&batch.mutex);
+	g_cond_clear(&batch.cond);
+	g_free(tiles);
+}
+static void draw_window(GralWindow *window, cairo_t *cr) {
+	if (window->render_threads > 1) {
+		draw_tiled(window, cr);
+	}
+	else {
+		draw_dirty_rectangles(window, cr);
+	}
+}
+static gboolean ensure_backing(GralWindow *window, GtkWidget *widget) {
+	// the backing surface is created by the first scroll and recreated whenever the size or scale of the widget changes
+	GdkWindow *gdk_window = gtk_widget_get_window(widget);
+	if (gdk_window == NULL) {
+		return FALSE;
+	}
+	int width = gtk_widget_get_allocated_width(widget);
+	int height = gtk_widget_get_allocated_height(widget);
+	int scale = gdk_window_get_scale_factor(gdk_window);
+	if (window->backing) {
+		double scale_x, scale_y;
+		cairo_surface_get_device_scale(window->backing, &scale_x, &scale_y);
+		if (cairo_image_surface_get_width(window->backing) == width * scale && cairo_image_surface_get_height(window->backing) == height * scale && scale_x == scale) {
+			return TRUE;
+		}
+		cairo_surface_destroy(window->backing);
+		cairo_region_destroy(window->backing_damage);
+	}
+	window->backing = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width * scale, height * scale);
+	cairo_surface_set_device_scale(window->backing, scale, scale);
+	cairo_rectangle_int_t bounds = {0, 0, width, height};
+	window->backing_damage = cairo_region_create_rectangle(&bounds);
+	return FALSE;
+}
+static void draw_retained(GralWindow *window, GtkWidget *widget, cairo_t *cr) {
+	// render only the damaged parts of the backing surface and copy it to the window
+	ensure_backing(window, widget);
+	if (!cairo_region_is_empty(window->backing_damage)) {
+		cairo_t *backing_cr = cairo_create(window->backing);
+		gdk_cairo_region(backing_cr, window->backing_damage);
+		cairo_clip(backing_cr);
+		cairo_region_destroy(window->backing_damage);
+		window->backing_damage = cairo_region_create();
+		draw_window(window, backing_cr);
+		cairo_destroy(backing_cr);
+	}
+	cairo_set_source_surface(cr, window->backing, 0, 0);
+	cairo_paint(cr);
+}
 static gboolean gral_widget_draw(GtkWidget *widget, cairo_t *cr) {
 	GralWindow *window = GRAL_WINDOW(gtk_widget_get_toplevel(widget));
-	GdkRectangle clip_rectangle;
-	gdk_cairo_get_clip_rectangle(cr, &clip_rectangle);
-	window->interface->draw((struct gral_draw_context *)cr, clip_rectangle.x, clip_rectangle.y, clip_rectangle.width, clip_rectangle.height, window->user_data);
+	double draw_start = gral_time_get_monotonic();
+	if (window->backing) {
+		draw_retained(window, widget, cr);
+	}
+	else {
+		draw_window(window, cr);
+	}
+	double flush_start = gral_time_get_monotonic();
+	cairo_surface_flush(cairo_get_target(cr));
+	double flush_end = gral_time_get_monotonic();
+	count_frame(flush_start - draw_start, flush_end - flush_start);
 	return GDK_EVENT_STOP;
 }
 static void gral_widget_size_allocate(GtkWidget *widget, GtkAllocation *allocation) {
@@ -606,6 +2521,10 @@ struct gral_window *gral_window_create(struct gral_application *application, int
 	window->cursor = GRAL_CURSOR_DEFAULT;
 	window->is_pointer_locked = FALSE;
 	window->last_key = GDK_KEY_VoidSymbol;
+	window->redraw_merge_threshold = G_MAXINT;
+	window->render_threads = 1;
+	window->backing = NULL;
+	window->backing_damage = NULL;
 	gtk_window_set_default_size(GTK_WINDOW(window), width, height);
 	gtk_window_set_title(GTK_WINDOW(window), title);
 	GtkWidget *widget = g_object_new(GRAL_TYPE_WIDGET, NULL);
@@ -623,14 +2542,116 @@ void gral_window_set_title(struct gral_window *window, char const *title) {
 
 void gral_window_request_redraw(struct gral_window *window, int x, int y, int width, int height) {
 	GtkWidget *widget = gtk_bin_get_child(GTK_BIN(window));
+	GralWindow *gral_window = GRAL_WINDOW(window);
+	if (gral_window->backing) {
+		cairo_rectangle_int_t rectangle = {x, y, width, height};
+		cairo_region_union_rectangle(gral_window->backing_damage, &rectangle);
+	}
 	gtk_widget_queue_draw_area(widget, x, y, width, height);
 }
 
+static void move_backing_pixels(cairo_surface_t *backing, cairo_rectangle_int_t const *destination, int dx, int dy) {
+	// the source and the destination overlap, so the rows are moved in the direction of the scroll
+	cairo_surface_flush(backing);
+	double scale;
+	cairo_surface_get_device_scale(backing, &scale, NULL);
+	int s = (int)scale;
+	unsigned char *data = cairo_image_surface_get_data(backing);
+	int stride = cairo_image_surface_get_stride(backing);
+	int rows = destination->height * s;
+	size_t row_size = (size_t)destination->width * s * 4;
+	for (int i = 0; i < rows; i++) {
+		int y = dy > 0 ? rows - 1 - i : i;
+		unsigned char *destination_row = data + (destination->y * s + y) * stride + destination->x * s * 4;
+		unsigned char *source_row = destination_row - dy * s * stride - dx * s * 4;
+		memmove(destination_row, source_row, row_size);
+	}
+	cairo_surface_mark_dirty(backing);
+}
+
+void gral_window_scroll(struct gral_window *window, int dx, int dy, int x, int y, int width, int height) {
+	GtkWidget *widget = gtk_bin_get_child(GTK_BIN(window));
+	GralWindow *gral_window = GRAL_WINDOW(window);
+	// gdk_window_move_region no longer copies pixels, so scrolling moves the pixels of a retained backing surface instead
+	if (!ensure_backing(gral_window, widget)) {
+		gtk_widget_queue_draw(widget);
+		return;
+	}
+	cairo_rectangle_int_t bounds = {0, 0, cairo_image_surface_get_width(gral_window->backing), cairo_image_surface_get_height(gral_window->backing)};
+	double scale;
+	cairo_surface_get_device_scale(gral_window->backing, &scale, NULL);
+	bounds.width /= (int)scale;
+	bounds.height /= (int)scale;
+	cairo_rectangle_int_t rectangle = {x, y, width, height};
+	gdk_rectangle_intersect(&rectangle, &bounds, &rectangle);
+	// the pixels that stay inside of the rectangle are moved, everything else is exposed
+	cairo_rectangle_int_t destination = {rectangle.x + dx, rectangle.y + dy, rectangle.width, rectangle.height};
+	if (gdk_rectangle_intersect(&rectangle, &destination, &destination)) {
+		move_backing_pixels(gral_window->backing, &destination, dx, dy);
+	}
+	else {
+		destination.width = destination.height = 0;
+	}
+	// damage that has not been rendered yet moves along with the pixels
+	cairo_region_t *moved_damage = cairo_region_copy(gral_window->backing_damage);
+	cairo_region_intersect_rectangle(moved_damage, &rectangle);
+	cairo_region_translate(moved_damage, dx, dy);
+	cairo_region_union_rectangle(gral_window->backing_damage, &rectangle);
+	cairo_region_subtract_rectangle(gral_window->backing_damage, &destination);
+	cairo_region_intersect_rectangle(moved_damage, &destination);
+	cairo_region_union(gral_window->backing_damage, moved_damage);
+	cairo_region_destroy(moved_damage);
+	gtk_widget_queue_draw_area(widget, rectangle.x, rectangle.y, rectangle.width, rectangle.height);
+}
+
+typedef struct {
+	void (*callback)(double presentation_time, double frame_interval, void *user_data);
+	void *user_data;
+} FrameCallbackData;
+static gboolean frame_callback(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data) {
+	FrameCallbackData *callback_data = user_data;
+	// the frame clock does not tick while the window is not visible, so hidden windows do not animate
+	gint64 frame_time = gdk_frame_clock_get_frame_time(frame_clock);
+	gint64 refresh_interval;
+	gint64 presentation_time;
+	gdk_frame_clock_get_refresh_info(frame_clock, frame_time, &refresh_interval, &presentation_time);
+	if (presentation_time == 0) {
+		presentation_time = frame_time + refresh_interval;
+	}
+	callback_data->callback(presentation_time / 1e6, refresh_interval / 1e6, callback_data->user_data);
+	return G_SOURCE_REMOVE;
+}
+static void frame_callback_destroy(gpointer user_data) {
+	FrameCallbackData *callback_data = user_data;
+	g_slice_free(FrameCallbackData, callback_data);
+}
+
+void gral_window_request_frame(struct gral_window *window, void (*callback)(double presentation_time, double frame_interval, void *user_data), void *user_data) {
+	FrameCallbackData *callback_data = g_slice_new(FrameCallbackData);
+	callback_data->callback = callback;
+	callback_data->user_data = user_data;
+	GtkWidget *widget = gtk_bin_get_child(GTK_BIN(window));
+	gtk_widget_add_tick_callback(widget, &frame_callback, callback_data, &frame_callback_destroy);
+}
+
 void gral_window_set_minimum_size(struct gral_window *window, int minimum_width, int minimum_height) {
 	GtkWidget *widget = gtk_bin_get_child(GTK_BIN(window));
 	gtk_widget_set_size_request(widget, minimum_width, minimum_height);
 }
 
+void gral_window_set_redraw_merge_threshold(struct gral_window *window, int threshold) {
+	GRAL_WINDOW(window)->redraw_merge_threshold = threshold;
+}
+
+void gral_window_set_render_threads(struct gral_window *window, int threads) {
+	// every window has its own pool of render threads
+	GralWindow *gral_window = GRAL_WINDOW(window);
+	gral_window->render_threads = threads;
+	if (gral_window->tile_pool && threads > 1) {
+		g_thread_pool_set_max_threads(gral_window->tile_pool, threads, NULL);
+	}
+}
+
 static char const *get_cursor_name(int cursor) {
 	switch (cursor) {
 	case GRAL_CURSOR_DEFAULT:
@@ -16,7 +16,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #import <CoreAudio/CoreAudio.h>
 #import <AudioUnit/AudioUnit.h>
 #import <CoreMIDI/CoreMIDI.h>
+#import <CoreVideo/CoreVideo.h>
 #include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
 #include <sys/event.h>
 
 static NSUInteger get_next_code_point(CFStringRef string, NSUInteger i, uint32_t *code_point) {
@@ -125,21 +128,174 @@ int gral_application_run(struct gral_application *application, int argc, char **
     DRAWING
  ============*/
 
+static struct gral_draw_statistics draw_statistics;
+static struct gral_draw_statistics reset_draw_statistics;
+static pthread_mutex_t draw_statistics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void count_draw_statistic(size_t *counter, size_t value) {
+	__atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static void get_draw_statistics(struct gral_draw_statistics *statistics) {
+	statistics->frames = __atomic_load_n(&draw_statistics.frames, __ATOMIC_RELAXED);
+	statistics->paths = __atomic_load_n(&draw_statistics.paths, __ATOMIC_RELAXED);
+	statistics->fills = __atomic_load_n(&draw_statistics.fills, __ATOMIC_RELAXED);
+	statistics->strokes = __atomic_load_n(&draw_statistics.strokes, __ATOMIC_RELAXED);
+	statistics->text_runs = __atomic_load_n(&draw_statistics.text_runs, __ATOMIC_RELAXED);
+	statistics->images = __atomic_load_n(&draw_statistics.images, __ATOMIC_RELAXED);
+	statistics->converted_bytes = __atomic_load_n(&draw_statistics.converted_bytes, __ATOMIC_RELAXED);
+	statistics->draw_time = draw_statistics.draw_time;
+	statistics->flush_time = draw_statistics.flush_time;
+}
+
+static void count_frame(double draw_time) {
+	// AppKit flushes the window after drawRect: returns, so there is no flush time to measure
+	pthread_mutex_lock(&draw_statistics_mutex);
+	count_draw_statistic(&draw_statistics.frames, 1);
+	draw_statistics.draw_time += draw_time;
+	pthread_mutex_unlock(&draw_statistics_mutex);
+}
+
+void gral_draw_statistics_get(struct gral_draw_statistics *statistics) {
+	struct gral_draw_statistics current;
+	pthread_mutex_lock(&draw_statistics_mutex);
+	get_draw_statistics(&current);
+	statistics->frames = current.frames - reset_draw_statistics.frames;
+	statistics->paths = current.paths - reset_draw_statistics.paths;
+	statistics->fills = current.fills - reset_draw_statistics.fills;
+	statistics->strokes = current.strokes - reset_draw_statistics.strokes;
+	statistics->text_runs = current.text_runs - reset_draw_statistics.text_runs;
+	statistics->images = current.images - reset_draw_statistics.images;
+	statistics->converted_bytes = current.converted_bytes - reset_draw_statistics.converted_bytes;
+	statistics->draw_time = current.draw_time - reset_draw_statistics.draw_time;
+	statistics->flush_time = current.flush_time - reset_draw_statistics.flush_time;
+	pthread_mutex_unlock(&draw_statistics_mutex);
+}
+
+void gral_draw_statistics_reset(void) {
+	pthread_mutex_lock(&draw_statistics_mutex);
+	get_draw_statistics(&reset_draw_statistics);
+	pthread_mutex_unlock(&draw_statistics_mutex);
+}
+
+struct gral_image {
+	int width;
+	int height;
+	int stride;
+	int format;
+	unsigned char *data;
+	int is_read_only;
+	CGDataProviderRef data_provider;
+	CGImageRef image;
+	NSMutableDictionary *sprite_images;
+};
+
+struct image_release_info {
+	void (*release)(void *data, void *user_data);
+	void *user_data;
+};
+
 static void image_release_callback(void *info, const void *data, size_t size) {
+	struct image_release_info *release_info = info;
+	if (release_info->release) {
+		release_info->release((void *)data, release_info->user_data);
+	}
+	free(release_info);
+}
+
+static void image_free_data(void *data, void *user_data) {
 	free(data);
 }
 
-struct gral_image *gral_image_create(int width, int height, void *data) {
+static void image_create_cg_image(struct gral_image *image) {
+	CGBitmapInfo bitmap_info = image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA ? kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst : kCGBitmapByteOrder32Big | kCGImageAlphaLast;
 	CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
-	CGDataProviderRef data_provider = CGDataProviderCreateWithData(NULL, data, width * height * 4, &image_release_callback);
-	CGImageRef image = CGImageCreate(width, height, 8, 8 * 4, width * 4, color_space, kCGBitmapByteOrder32Big | kCGImageAlphaLast, data_provider, NULL, NO, kCGRenderingIntentDefault);
-	CGDataProviderRelease(data_provider);
+	image->image = CGImageCreate(image->width, image->height, 8, 8 * 4, image->stride, color_space, bitmap_info, image->data_provider, NULL, NO, kCGRenderingIntentDefault);
 	CGColorSpaceRelease(color_space);
-	return (struct gral_image *)image;
+}
+
+static void premultiply_row(unsigned char const *source, unsigned char *destination, int width) {
+	for (int x = 0; x < width; x++) {
+		unsigned int a = source[3];
+		destination[0] = (source[2] * a + 127) / 255;
+		destination[1] = (source[1] * a + 127) / 255;
+		destination[2] = (source[0] * a + 127) / 255;
+		destination[3] = a;
+		source += 4;
+		destination += 4;
+	}
+}
+
+struct gral_image *gral_image_create(int width, int height, void *data) {
+	struct gral_image *image = gral_image_create_from_data(width, height, width * 4, GRAL_PIXEL_FORMAT_RGBA, data, &image_free_data, NULL);
+	image->is_read_only = 0;
+	return image;
+}
+
+struct gral_image *gral_image_create_from_data(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data) {
+	struct gral_image *image = malloc(sizeof(struct gral_image));
+	image->width = width;
+	image->height = height;
+	image->stride = stride;
+	image->format = format;
+	image->data = data;
+	// the data may be read-only, so images created from it are never updated
+	image->is_read_only = 1;
+	struct image_release_info *release_info = malloc(sizeof(struct image_release_info));
+	release_info->release = release;
+	release_info->user_data = user_data;
+	image->data_provider = CGDataProviderCreateWithData(release_info, data, stride * height, &image_release_callback);
+	image_create_cg_image(image);
+	image->sprite_images = nil;
+	return image;
 }
 
 void gral_image_delete(struct gral_image *image) {
-	CGImageRelease((CGImageRef)image);
+	[image->sprite_images release];
+	CGImageRelease(image->image);
+	CGDataProviderRelease(image->data_provider);
+	free(image);
+}
+
+void gral_image_update(struct gral_image *image, int x, int y, int width, int height, void const *data) {
+	if (image->is_read_only) {
+		return;
+	}
+	// only the part of the rectangle that lies within the image is updated
+	int source_stride = width * 4;
+	unsigned char const *source_data = data;
+	if (x < 0) {
+		source_data -= x * 4;
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		source_data -= y * source_stride;
+		height += y;
+		y = 0;
+	}
+	width = MIN(width, image->width - x);
+	height = MIN(height, image->height - y);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	if (image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA) {
+		count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	}
+	for (int i = 0; i < height; i++) {
+		unsigned char *destination = image->data + (y + i) * image->stride + x * 4;
+		unsigned char const *source = source_data + i * source_stride;
+		if (image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA) {
+			premultiply_row(source, destination, width);
+		}
+		else {
+			memcpy(destination, source, width * 4);
+		}
+	}
+	// CoreGraphics may cache the decoded pixels of a CGImage, so create a new one
+	CGImageRelease(image->image);
+	image_create_cg_image(image);
+	[image->sprite_images removeAllObjects];
 }
 
 struct gral_font *gral_font_create(struct gral_window *window, char const *name, float size) {
@@ -215,15 +371,107 @@ void gral_text_set_color(struct gral_text *text, int start_index, int end_index,
 	CGColorRelease(color);
 }
 
+void gral_text_set_spans(struct gral_text *text, struct gral_text_span const *spans, int count) {
+	CFAttributedStringBeginEditing((CFMutableAttributedStringRef)text);
+	for (int i = 0; i < count; i++) {
+		struct gral_text_span const *span = &spans[i];
+		if (span->style & GRAL_TEXT_STYLE_BOLD) {
+			gral_text_set_bold(text, span->start_index, span->end_index);
+		}
+		if (span->style & GRAL_TEXT_STYLE_ITALIC) {
+			gral_text_set_italic(text, span->start_index, span->end_index);
+		}
+		gral_text_set_color(text, span->start_index, span->end_index, span->red, span->green, span->blue, span->alpha);
+	}
+	CFAttributedStringEndEditing((CFMutableAttributedStringRef)text);
+}
+
+typedef struct TextCacheEntry {
+	CFAttributedStringRef key;
+	CTLineRef line;
+	struct TextCacheEntry *previous;
+	struct TextCacheEntry *next;
+} TextCacheEntry;
+static struct {
+	int capacity;
+	CFMutableDictionaryRef entries;
+	TextCacheEntry *head;
+	TextCacheEntry *tail;
+	size_t hits;
+	size_t misses;
+} text_cache;
+
+static void text_cache_unlink(TextCacheEntry *entry) {
+	if (entry->previous) {
+		entry->previous->next = entry->next;
+	}
+	else {
+		text_cache.head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->previous = entry->previous;
+	}
+	else {
+		text_cache.tail = entry->previous;
+	}
+}
+
+static void text_cache_push_head(TextCacheEntry *entry) {
+	entry->previous = NULL;
+	entry->next = text_cache.head;
+	if (text_cache.head) {
+		text_cache.head->previous = entry;
+	}
+	else {
+		text_cache.tail = entry;
+	}
+	text_cache.head = entry;
+}
+
+static void text_cache_evict(int capacity) {
+	while (text_cache.entries && CFDictionaryGetCount(text_cache.entries) > capacity) {
+		TextCacheEntry *entry = text_cache.tail;
+		text_cache_unlink(entry);
+		CFDictionaryRemoveValue(text_cache.entries, entry->key);
+		CFRelease(entry->key);
+		CFRelease(entry->line);
+		free(entry);
+	}
+}
+
+static CTLineRef create_line(struct gral_text *text) {
+	// an attributed string compares equal to another one with the same string and attributes, so identical texts share the typeset line
+	if (text_cache.capacity == 0) {
+		return CTLineCreateWithAttributedString((CFAttributedStringRef)text);
+	}
+	TextCacheEntry *entry = (TextCacheEntry *)CFDictionaryGetValue(text_cache.entries, text);
+	if (entry) {
+		text_cache_unlink(entry);
+		text_cache_push_head(entry);
+		text_cache.hits++;
+	}
+	else {
+		entry = malloc(sizeof(TextCacheEntry));
+		// the text can still be changed, so the key is an immutable copy
+		entry->key = CFAttributedStringCreateCopy(NULL, (CFAttributedStringRef)text);
+		entry->line = CTLineCreateWithAttributedString(entry->key);
+		CFDictionarySetValue(text_cache.entries, entry->key, entry);
+		text_cache_push_head(entry);
+		text_cache.misses++;
+		text_cache_evict(text_cache.capacity);
+	}
+	return CFRetain(entry->line);
+}
+
 float gral_text_get_width(struct gral_text *text) {
-	CTLineRef line = CTLineCreateWithAttributedString((CFAttributedStringRef)text);
+	CTLineRef line = create_line(text);
 	double width = CTLineGetTypographicBounds(line, NULL, NULL, NULL);
 	CFRelease(line);
 	return width;
 }
 
 float gral_text_index_to_x(struct gral_text *text, int index) {
-	CTLineRef line = CTLineCreateWithAttributedString((CFAttributedStringRef)text);
+	CTLineRef line = create_line(text);
 	CFStringRef string = CFAttributedStringGetString((CFAttributedStringRef)text);
 	CGFloat offset = CTLineGetOffsetForStringIndex(line, utf8_index_to_utf16(string, index), NULL);
 	CFRelease(line);
@@ -231,7 +479,7 @@ float gral_text_index_to_x(struct gral_text *text, int index) {
 }
 
 int gral_text_x_to_index(struct gral_text *text, float x) {
-	CTLineRef line = CTLineCreateWithAttributedString((CFAttributedStringRef)text);
+	CTLineRef line = create_line(text);
 	CFIndex index = CTLineGetStringIndexForPosition(line, CGPointMake(x, 0.0f));
 	CFRelease(line);
 	if (index == kCFNotFound) {
@@ -241,17 +489,329 @@ int gral_text_x_to_index(struct gral_text *text, float x) {
 	return utf16_index_to_utf8(string, index);
 }
 
+void gral_text_cache_set_capacity(int capacity) {
+	if (text_cache.entries == NULL) {
+		text_cache.entries = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, NULL);
+	}
+	text_cache_evict(capacity);
+	text_cache.capacity = capacity;
+}
+
+void gral_text_cache_get_statistics(size_t *hits, size_t *misses) {
+	if (hits) *hits = text_cache.hits;
+	if (misses) *misses = text_cache.misses;
+}
+
+struct gral_path *gral_path_create(void) {
+	return (struct gral_path *)CGPathCreateMutable();
+}
+
+void gral_path_delete(struct gral_path *path) {
+	CFRelease((CGMutablePathRef)path);
+}
+
+void gral_path_close_path(struct gral_path *path) {
+	CGPathCloseSubpath((CGMutablePathRef)path);
+}
+
+void gral_path_move_to(struct gral_path *path, float x, float y) {
+	CGPathMoveToPoint((CGMutablePathRef)path, NULL, x, y);
+}
+
+void gral_path_line_to(struct gral_path *path, float x, float y) {
+	CGPathAddLineToPoint((CGMutablePathRef)path, NULL, x, y);
+}
+
+void gral_path_curve_to(struct gral_path *path, float x1, float y1, float x2, float y2, float x, float y) {
+	CGPathAddCurveToPoint((CGMutablePathRef)path, NULL, x1, y1, x2, y2, x, y);
+}
+
+#define SAMPLE_PYRAMID_FACTOR 8
+#define SAMPLE_PYRAMID_MAX_LEVELS 10
+typedef struct {
+	float *minimum;
+	float *maximum;
+} SamplePyramidLevel;
+struct gral_sample_pyramid {
+	int level_count;
+	SamplePyramidLevel levels[SAMPLE_PYRAMID_MAX_LEVELS];
+};
+
+static void min_max(float const *minimum, float const *maximum, int count, float *min, float *max) {
+	for (int i = 0; i < count; i++) {
+		*min = MIN(*min, minimum[i]);
+		*max = MAX(*max, maximum[i]);
+	}
+}
+
+struct gral_sample_pyramid *gral_sample_pyramid_create(float const *samples, int count) {
+	// level n stores the minimum and maximum of blocks of SAMPLE_PYRAMID_FACTOR^(n+1) samples
+	struct gral_sample_pyramid *pyramid = malloc(sizeof(struct gral_sample_pyramid));
+	pyramid->level_count = 0;
+	float const *minimum = samples;
+	float const *maximum = samples;
+	while (count > SAMPLE_PYRAMID_FACTOR && pyramid->level_count < SAMPLE_PYRAMID_MAX_LEVELS) {
+		int block_count = (count + SAMPLE_PYRAMID_FACTOR - 1) / SAMPLE_PYRAMID_FACTOR;
+		SamplePyramidLevel *level = &pyramid->levels[pyramid->level_count];
+		level->minimum = malloc(block_count * sizeof(float));
+		level->maximum = malloc(block_count * sizeof(float));
+		for (int i = 0; i < block_count; i++) {
+			int start = i * SAMPLE_PYRAMID_FACTOR;
+			level->minimum[i] = minimum[start];
+			level->maximum[i] = maximum[start];
+			min_max(minimum + start, maximum + start, MIN(SAMPLE_PYRAMID_FACTOR, count - start), &level->minimum[i], &level->maximum[i]);
+		}
+		minimum = level->minimum;
+		maximum = level->maximum;
+		count = block_count;
+		pyramid->level_count++;
+	}
+	return pyramid;
+}
+
+void gral_sample_pyramid_delete(struct gral_sample_pyramid *pyramid) {
+	for (int i = 0; i < pyramid->level_count; i++) {
+		free(pyramid->levels[i].minimum);
+		free(pyramid->levels[i].maximum);
+	}
+	free(pyramid);
+}
+
+static void get_samples_min_max(float const *samples, struct gral_sample_pyramid const *pyramid, int start, int end, float *min, float *max) {
+	// use the coarsest level that covers at least two whole blocks and scan the remainders on both sides with finer levels
+	int level = -1;
+	int block_size = 1;
+	if (pyramid) {
+		while (level + 1 < pyramid->level_count && end - start >= block_size * SAMPLE_PYRAMID_FACTOR * 2) {
+			level++;
+			block_size *= SAMPLE_PYRAMID_FACTOR;
+		}
+	}
+	if (level < 0) {
+		min_max(samples + start, samples + start, end - start, min, max);
+		return;
+	}
+	int first_block = (start + block_size - 1) / block_size;
+	int last_block = end / block_size;
+	min_max(pyramid->levels[level].minimum + first_block, pyramid->levels[level].maximum + first_block, last_block - first_block, min, max);
+	get_samples_min_max(samples, pyramid, start, first_block * block_size, min, max);
+	get_samples_min_max(samples, pyramid, last_block * block_size, end, min, max);
+}
+
+struct gral_layer {
+	int width;
+	int height;
+	CGLayerRef layer;
+	int is_valid;
+};
+
+struct gral_layer *gral_layer_create(int width, int height) {
+	struct gral_layer *layer = malloc(sizeof(struct gral_layer));
+	layer->width = width;
+	layer->height = height;
+	layer->layer = NULL;
+	layer->is_valid = 0;
+	return layer;
+}
+
+void gral_layer_delete(struct gral_layer *layer) {
+	CGLayerRelease(layer->layer);
+	free(layer);
+}
+
+void gral_layer_invalidate(struct gral_layer *layer) {
+	layer->is_valid = 0;
+}
+
+// a CGContext has no user data, so the culling margins are kept by context until culling is disabled or the context goes away
+static CFMutableDictionaryRef culling_margins;
+static pthread_mutex_t culling_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_culling_margin(CGContextRef context, CFNumberRef margin) {
+	pthread_mutex_lock(&culling_mutex);
+	if (culling_margins == NULL) {
+		culling_margins = CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+	}
+	if (margin) {
+		CFDictionarySetValue(culling_margins, context, margin);
+	}
+	else {
+		CFDictionaryRemoveValue(culling_margins, context);
+	}
+	pthread_mutex_unlock(&culling_mutex);
+}
+
+static int is_culled(CGContextRef context, CGFloat x1, CGFloat y1, CGFloat x2, CGFloat y2) {
+	pthread_mutex_lock(&culling_mutex);
+	CFNumberRef number = culling_margins ? CFDictionaryGetValue(culling_margins, context) : NULL;
+	CGFloat margin = 0.0;
+	if (number) {
+		CFNumberGetValue(number, kCFNumberCGFloatType, &margin);
+	}
+	pthread_mutex_unlock(&culling_mutex);
+	if (number == NULL) {
+		return 0;
+	}
+	// the clip bounding box is in user space, so this is conservative under rotations
+	CGRect clip = CGContextGetClipBoundingBox(context);
+	return x1 - margin > CGRectGetMaxX(clip) || x2 + margin < CGRectGetMinX(clip) || y1 - margin > CGRectGetMaxY(clip) || y2 + margin < CGRectGetMinY(clip);
+}
+
+static int is_points_culled(CGContextRef context, struct gral_point const *points, int count) {
+	CGFloat x1 = points[0].x, y1 = points[0].y, x2 = points[0].x, y2 = points[0].y;
+	for (int i = 1; i < count; i++) {
+		x1 = MIN(x1, points[i].x);
+		y1 = MIN(y1, points[i].y);
+		x2 = MAX(x2, points[i].x);
+		y2 = MAX(y2, points[i].y);
+	}
+	return is_culled(context, x1, y1, x2, y2);
+}
+
+static int is_line_culled(CGContextRef context, CTLineRef line, float x, float y) {
+	// the text matrix flips the glyphs, so the glyph bounds are flipped as well
+	CGRect bounds = CTLineGetBoundsWithOptions(line, kCTLineBoundsUseGlyphPathBounds);
+	return is_culled(context, x + CGRectGetMinX(bounds), y - CGRectGetMaxY(bounds), x + CGRectGetMaxX(bounds), y - CGRectGetMinY(bounds));
+}
+
+struct gral_draw_context *gral_draw_context_create(int width, int height) {
+	CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
+	CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, width * 4, color_space, kCGBitmapByteOrder32Big | kCGImageAlphaPremultipliedLast);
+	CGColorSpaceRelease(color_space);
+	// use the same flipped coordinate system as the window
+	CGContextTranslateCTM(context, 0.0f, height);
+	CGContextScaleCTM(context, 1.0f, -1.0f);
+	return (struct gral_draw_context *)context;
+}
+
+void gral_draw_context_delete(struct gral_draw_context *draw_context) {
+	set_culling_margin((CGContextRef)draw_context, NULL);
+	CGContextRelease((CGContextRef)draw_context);
+}
+
+void gral_draw_context_get_pixels(struct gral_draw_context *draw_context, void *data) {
+	CGContextFlush((CGContextRef)draw_context);
+	int width = CGBitmapContextGetWidth((CGContextRef)draw_context);
+	int height = CGBitmapContextGetHeight((CGContextRef)draw_context);
+	size_t stride = CGBitmapContextGetBytesPerRow((CGContextRef)draw_context);
+	unsigned char const *context_data = CGBitmapContextGetData((CGContextRef)draw_context);
+	unsigned char *destination = data;
+	count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	for (int y = 0; y < height; y++) {
+		unsigned char const *source = context_data + y * stride;
+		for (int x = 0; x < width; x++) {
+			unsigned int a = source[3];
+			for (int i = 0; i < 3; i++) {
+				destination[i] = a == 0 ? 0 : (source[i] * 255 + a / 2) / a;
+			}
+			destination[3] = a;
+			source += 4;
+			destination += 4;
+		}
+	}
+}
+
 void gral_draw_context_draw_image(struct gral_draw_context *draw_context, struct gral_image *image, float x, float y) {
-	size_t width = CGImageGetWidth((CGImageRef)image);
-	size_t height = CGImageGetHeight((CGImageRef)image);
+	count_draw_statistic(&draw_statistics.images, 1);
 	CGContextScaleCTM((CGContextRef)draw_context, 1.0f, -1.0f);
-	CGContextDrawImage((CGContextRef)draw_context, CGRectMake(x, -(y + height), width, height), (CGImageRef)image);
+	CGContextDrawImage((CGContextRef)draw_context, CGRectMake(x, -(y + image->height), image->width, image->height), image->image);
 	CGContextScaleCTM((CGContextRef)draw_context, 1.0f, -1.0f);
 }
 
-void gral_draw_context_draw_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y, float red, float green, float blue, float alpha) {
-	CTLineRef line = CTLineCreateWithAttributedString((CFAttributedStringRef)text);
-	CGContextSetTextMatrix((CGContextRef)draw_context, CGAffineTransformMakeScale(1.0f, -1.0f));
+void gral_draw_context_draw_image_scaled(struct gral_draw_context *draw_context, struct gral_image *image, float source_x, float source_y, float source_width, float source_height, float x, float y, float width, float height, int filter) {
+	if (source_width <= 0.0f || source_height <= 0.0f) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	CGContextRef context = (CGContextRef)draw_context;
+	CGContextSaveGState(context);
+	CGContextClipToRect(context, CGRectMake(x, y, width, height));
+	CGContextSetInterpolationQuality(context, filter == GRAL_IMAGE_FILTER_NEAREST ? kCGInterpolationNone : filter == GRAL_IMAGE_FILTER_SMOOTH ? kCGInterpolationHigh : kCGInterpolationDefault);
+	// map the source rectangle onto the destination rectangle and draw the whole image
+	float scale_x = width / source_width;
+	float scale_y = height / source_height;
+	float image_y = y - source_y * scale_y;
+	float image_height = image->height * scale_y;
+	CGContextScaleCTM(context, 1.0f, -1.0f);
+	CGContextDrawImage(context, CGRectMake(x - source_x * scale_x, -(image_y + image_height), image->width * scale_x, image_height), image->image);
+	CGContextRestoreGState(context);
+}
+
+static CGImageRef get_sprite_image(struct gral_image *image, struct gral_sprite const *sprite) {
+	// the sub-images are cached in the atlas so that they are not created again for every sprite in every frame
+	CGRect source_rect = CGRectMake(sprite->source_x, sprite->source_y, sprite->width, sprite->height);
+	if (image->sprite_images == nil) {
+		image->sprite_images = [[NSMutableDictionary alloc] init];
+	}
+	NSValue *key = [NSValue valueWithRect:NSRectFromCGRect(source_rect)];
+	CGImageRef sprite_image = (CGImageRef)[image->sprite_images objectForKey:key];
+	if (sprite_image == NULL) {
+		sprite_image = CGImageCreateWithImageInRect(image->image, source_rect);
+		if (sprite_image == NULL) {
+			return NULL;
+		}
+		[image->sprite_images setObject:(id)sprite_image forKey:key];
+		CGImageRelease(sprite_image);
+	}
+	return sprite_image;
+}
+
+void gral_draw_context_draw_sprites(struct gral_draw_context *draw_context, struct gral_image *image, struct gral_sprite const *sprites, int count, int tinted) {
+	CGContextRef context = (CGContextRef)draw_context;
+	count_draw_statistic(&draw_statistics.images, count);
+	for (int i = 0; i < count; i++) {
+		struct gral_sprite const *sprite = &sprites[i];
+		CGImageRef sprite_image = get_sprite_image(image, sprite);
+		if (sprite_image == NULL) {
+			continue;
+		}
+		CGRect rect = CGRectMake(sprite->x, -(sprite->y + sprite->height), sprite->width, sprite->height);
+		CGContextSaveGState(context);
+		CGContextScaleCTM(context, 1.0f, -1.0f);
+		if (tinted) {
+			// the sprite is used as a mask: filling it with the color in source-in mode keeps only the alpha of the sprite
+			CGContextBeginTransparencyLayerWithRect(context, rect, NULL);
+			CGContextDrawImage(context, rect, sprite_image);
+			CGContextSetBlendMode(context, kCGBlendModeSourceIn);
+			CGContextSetRGBFillColor(context, sprite->red, sprite->green, sprite->blue, sprite->alpha);
+			CGContextFillRect(context, rect);
+			CGContextEndTransparencyLayer(context);
+		}
+		else {
+			CGContextSetAlpha(context, sprite->alpha);
+			CGContextDrawImage(context, rect, sprite_image);
+		}
+		CGContextRestoreGState(context);
+	}
+}
+
+void gral_draw_context_draw_layer(struct gral_draw_context *draw_context, struct gral_layer *layer, float x, float y, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data) {
+	if (layer->layer == NULL) {
+		layer->layer = CGLayerCreateWithContext((CGContextRef)draw_context, CGSizeMake(layer->width, layer->height), NULL);
+	}
+	if (!layer->is_valid) {
+		CGContextRef context = CGLayerGetContext(layer->layer);
+		CGContextClearRect(context, CGRectMake(0, 0, layer->width, layer->height));
+		CGContextSaveGState(context);
+		CGContextTranslateCTM(context, 0.0f, layer->height);
+		CGContextScaleCTM(context, 1.0f, -1.0f);
+		callback((struct gral_draw_context *)context, user_data);
+		CGContextRestoreGState(context);
+		set_culling_margin(context, NULL);
+		layer->is_valid = 1;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	CGContextScaleCTM((CGContextRef)draw_context, 1.0f, -1.0f);
+	CGContextDrawLayerInRect((CGContextRef)draw_context, CGRectMake(x, -(y + layer->height), layer->width, layer->height), layer->layer);
+	CGContextScaleCTM((CGContextRef)draw_context, 1.0f, -1.0f);
+}
+
+static void draw_text_line(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y, float red, float green, float blue, float alpha) {
+	CTLineRef line = create_line(text);
+	if (is_line_culled((CGContextRef)draw_context, line, x, y)) {
+		CFRelease(line);
+		return;
+	}
 	CFArrayRef glyph_runs = CTLineGetGlyphRuns(line);
 	for (int i = 0; i < CFArrayGetCount(glyph_runs); i++) {
 		CTRunRef run = CFArrayGetValueAtIndex(glyph_runs, i);
@@ -272,9 +832,27 @@ void gral_draw_context_draw_text(struct gral_draw_context *draw_context, struct
 	}
 	CFRelease(line);
 }
+void gral_draw_context_draw_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.text_runs, 1);
+	CGContextSetTextMatrix((CGContextRef)draw_context, CGAffineTransformMakeScale(1.0f, -1.0f));
+	draw_text_line(draw_context, text, x, y, red, green, blue, alpha);
+}
+
+void gral_draw_context_draw_text_batch(struct gral_draw_context *draw_context, struct gral_text_run const *runs, int count) {
+	// Core Text draws every line with its own glyph runs anyway, so the runs are drawn in order and only the text matrix is shared
+	count_draw_statistic(&draw_statistics.text_runs, count);
+	CGContextSetTextMatrix((CGContextRef)draw_context, CGAffineTransformMakeScale(1.0f, -1.0f));
+	for (int i = 0; i < count; i++) {
+		draw_text_line(draw_context, runs[i].text, runs[i].x, runs[i].y, runs[i].red, runs[i].green, runs[i].blue, runs[i].alpha);
+	}
+}
 
 void gral_draw_context_add_text(struct gral_draw_context *draw_context, struct gral_text *text, float x, float y) {
-	CTLineRef line = CTLineCreateWithAttributedString((CFAttributedStringRef)text);
+	CTLineRef line = create_line(text);
+	if (is_line_culled((CGContextRef)draw_context, line, x, y)) {
+		CFRelease(line);
+		return;
+	}
 	CGContextSetTextMatrix((CGContextRef)draw_context, CGAffineTransformMakeScale(1.0f, -1.0f));
 	CFArrayRef glyph_runs = CTLineGetGlyphRuns(line);
 	for (int i = 0; i < CFArrayGetCount(glyph_runs); i++) {
@@ -295,11 +873,21 @@ void gral_draw_context_add_text(struct gral_draw_context *draw_context, struct g
 	CFRelease(line);
 }
 
+void gral_draw_context_add_path(struct gral_draw_context *draw_context, struct gral_path *path) {
+	CGRect bounds = CGPathGetBoundingBox((CGPathRef)path);
+	if (CGRectIsNull(bounds) || is_culled((CGContextRef)draw_context, CGRectGetMinX(bounds), CGRectGetMinY(bounds), CGRectGetMaxX(bounds), CGRectGetMaxY(bounds))) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	CGContextAddPath((CGContextRef)draw_context, (CGPathRef)path);
+}
+
 void gral_draw_context_close_path(struct gral_draw_context *draw_context) {
 	CGContextClosePath((CGContextRef)draw_context);
 }
 
 void gral_draw_context_move_to(struct gral_draw_context *draw_context, float x, float y) {
+	count_draw_statistic(&draw_statistics.paths, 1);
 	CGContextMoveToPoint((CGContextRef)draw_context, x, y);
 }
 
@@ -311,12 +899,133 @@ void gral_draw_context_curve_to(struct gral_draw_context *draw_context, float x1
 	CGContextAddCurveToPoint((CGContextRef)draw_context, x1, y1, x2, y2, x, y);
 }
 
+void gral_draw_context_add_polyline(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed) {
+	if (count < 1 || is_points_culled((CGContextRef)draw_context, points, count)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	CGPoint *cg_points = malloc(count * sizeof(CGPoint));
+	for (int i = 0; i < count; i++) {
+		cg_points[i] = CGPointMake(points[i].x, points[i].y);
+	}
+	CGContextAddLines((CGContextRef)draw_context, cg_points, count);
+	free(cg_points);
+	if (closed) {
+		CGContextClosePath((CGContextRef)draw_context);
+	}
+}
+
+void gral_draw_context_add_curves(struct gral_draw_context *draw_context, struct gral_point const *points, int count, int closed) {
+	if (count < 1 || is_points_culled((CGContextRef)draw_context, points, count)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	CGContextMoveToPoint((CGContextRef)draw_context, points[0].x, points[0].y);
+	for (int i = 1; i + 2 < count; i += 3) {
+		CGContextAddCurveToPoint((CGContextRef)draw_context, points[i].x, points[i].y, points[i + 1].x, points[i + 1].y, points[i + 2].x, points[i + 2].y);
+	}
+	if (closed) {
+		CGContextClosePath((CGContextRef)draw_context);
+	}
+}
+
+void gral_draw_context_add_samples(struct gral_draw_context *draw_context, float const *samples, int count, struct gral_sample_pyramid *pyramid, float x, float y, float x_scale, float y_scale) {
+	if (count < 1) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	CGContextRef context = (CGContextRef)draw_context;
+	// device space includes the backing scale factor, so the columns are physical pixels
+	CGAffineTransform ctm = CGContextGetCTM(context);
+	double dx = CGContextConvertSizeToDeviceSpace(context, CGSizeMake(x_scale, 0.0f)).width;
+	if (ctm.b != 0.0 || ctm.c != 0.0 || x_scale <= 0.0f || dx <= 0.0 || dx > 0.25) {
+		CGContextMoveToPoint(context, x, y + samples[0] * y_scale);
+		for (int i = 1; i < count; i++) {
+			CGContextAddLineToPoint(context, x + (double)i * x_scale, y + samples[i] * y_scale);
+		}
+		return;
+	}
+	// reduce the samples of every device pixel column to its first, minimum, maximum and last value, which rasterizes identically
+	double device_x = CGContextConvertPointToDeviceSpace(context, CGPointMake(x, y)).x;
+	CGContextMoveToPoint(context, x, y + samples[0] * y_scale);
+	int i = 0;
+	while (i < count) {
+		double column = floor(device_x + i * dx);
+		int next = (int)MIN(ceil((column + 1.0 - device_x) / dx), (double)count);
+		if (next <= i) {
+			next = i + 1;
+		}
+		float min = samples[i];
+		float max = samples[i];
+		get_samples_min_max(samples, pyramid, i, next, &min, &max);
+		double column_x = x + (double)i * x_scale;
+		CGContextAddLineToPoint(context, column_x, y + samples[i] * y_scale);
+		CGContextAddLineToPoint(context, column_x, y + min * y_scale);
+		CGContextAddLineToPoint(context, column_x, y + max * y_scale);
+		CGContextAddLineToPoint(context, x + (double)(next - 1) * x_scale, y + samples[next - 1] * y_scale);
+		i = next;
+	}
+}
+
 void gral_draw_context_fill(struct gral_draw_context *draw_context, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.fills, 1);
 	CGContextSetRGBFillColor((CGContextRef)draw_context, red, green, blue, alpha);
 	CGContextFillPath((CGContextRef)draw_context);
 }
 
-void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
+static CGPathRef take_current_path(CGContextRef context) {
+	// the rectangle functions fill only the rectangles and leave the current path as it was
+	if (CGContextIsPathEmpty(context)) {
+		return NULL;
+	}
+	CGPathRef path = CGContextCopyPath(context);
+	CGContextBeginPath(context);
+	return path;
+}
+
+static void restore_current_path(CGContextRef context, CGPathRef path) {
+	if (path) {
+		CGContextAddPath(context, path);
+		CGPathRelease(path);
+	}
+}
+
+void gral_draw_context_fill_rectangles(struct gral_draw_context *draw_context, struct gral_rectangle const *rectangles, int count, float red, float green, float blue, float alpha) {
+	CGContextRef context = (CGContextRef)draw_context;
+	CGPathRef path = take_current_path(context);
+	count_draw_statistic(&draw_statistics.fills, 1);
+	CGContextSetRGBFillColor(context, red, green, blue, alpha);
+	for (int i = 0; i < count; i++) {
+		CGContextAddRect(context, CGRectMake(rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height));
+	}
+	CGContextFillPath(context);
+	restore_current_path(context, path);
+}
+
+void gral_draw_context_fill_colored_rectangles(struct gral_draw_context *draw_context, struct gral_colored_rectangle const *rectangles, int count) {
+	CGContextRef context = (CGContextRef)draw_context;
+	CGPathRef path = take_current_path(context);
+	count_draw_statistic(&draw_statistics.fills, 1);
+	for (int i = 0; i < count; i++) {
+		CGContextSetRGBFillColor(context, rectangles[i].red, rectangles[i].green, rectangles[i].blue, rectangles[i].alpha);
+		CGContextFillRect(context, CGRectMake(rectangles[i].x, rectangles[i].y, rectangles[i].width, rectangles[i].height));
+	}
+	restore_current_path(context, path);
+}
+
+void gral_draw_context_fill_path_instances(struct gral_draw_context *draw_context, struct gral_path *path, struct gral_path_instance const *instances, int count) {
+	count_draw_statistic(&draw_statistics.paths, 1);
+	count_draw_statistic(&draw_statistics.fills, count);
+	for (int i = 0; i < count; i++) {
+		CGContextTranslateCTM((CGContextRef)draw_context, instances[i].x, instances[i].y);
+		CGContextAddPath((CGContextRef)draw_context, (CGPathRef)path);
+		CGContextTranslateCTM((CGContextRef)draw_context, -instances[i].x, -instances[i].y);
+		CGContextSetRGBFillColor((CGContextRef)draw_context, instances[i].red, instances[i].green, instances[i].blue, instances[i].alpha);
+		CGContextFillPath((CGContextRef)draw_context);
+	}
+}
+
+static void draw_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
 	CGFloat components[count*4];
 	CGFloat locations[count];
 	for (int i = 0; i < count; i++) {
@@ -336,7 +1045,13 @@ void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_conte
 	CGColorSpaceRelease(color_space);
 }
 
+void gral_draw_context_fill_linear_gradient(struct gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, struct gral_gradient_stop const *stops, int count) {
+	count_draw_statistic(&draw_statistics.fills, 1);
+	draw_linear_gradient(draw_context, start_x, start_y, end_x, end_y, stops, count);
+}
+
 void gral_draw_context_stroke(struct gral_draw_context *draw_context, float line_width, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.strokes, 1);
 	CGContextSetLineWidth((CGContextRef)draw_context, line_width);
 	CGContextSetLineCap((CGContextRef)draw_context, kCGLineCapRound);
 	CGContextSetLineJoin((CGContextRef)draw_context, kCGLineJoinRound);
@@ -349,7 +1064,8 @@ void gral_draw_context_stroke_linear_gradient(struct gral_draw_context *draw_con
 	CGContextSetLineCap((CGContextRef)draw_context, kCGLineCapRound);
 	CGContextSetLineJoin((CGContextRef)draw_context, kCGLineJoinRound);
 	CGContextReplacePathWithStrokedPath((CGContextRef)draw_context);
-	gral_draw_context_fill_linear_gradient(draw_context, start_x, start_y, end_x, end_y, stops, count);
+	count_draw_statistic(&draw_statistics.strokes, 1);
+	draw_linear_gradient(draw_context, start_x, start_y, end_x, end_y, stops, count);
 }
 
 void gral_draw_context_draw_clipped(struct gral_draw_context *draw_context, void (*callback)(struct gral_draw_context *draw_context, void *user_data), void *user_data) {
@@ -366,6 +1082,22 @@ void gral_draw_context_draw_transformed(struct gral_draw_context *draw_context,
 	CGContextRestoreGState((CGContextRef)draw_context);
 }
 
+int gral_draw_context_is_rectangle_visible(struct gral_draw_context *draw_context, float x, float y, float width, float height) {
+	return CGRectIntersectsRect(CGContextGetClipBoundingBox((CGContextRef)draw_context), CGRectMake(x, y, width, height));
+}
+
+void gral_draw_context_set_culling(struct gral_draw_context *draw_context, int enabled, float margin) {
+	if (enabled) {
+		CGFloat cg_margin = margin;
+		CFNumberRef number = CFNumberCreate(NULL, kCFNumberCGFloatType, &cg_margin);
+		set_culling_margin((CGContextRef)draw_context, number);
+		CFRelease(number);
+	}
+	else {
+		set_culling_margin((CGContextRef)draw_context, NULL);
+	}
+}
+
 
 /*===========
     WINDOW
@@ -542,10 +1274,22 @@ static int get_modifiers(NSEventModifierFlags modifier_flags) {
 	return modifiers;
 }
 
+struct frame_callback_data {
+	void (*callback)(double presentation_time, double frame_interval, void *user_data);
+	void *user_data;
+	struct frame_callback_data *next;
+};
+
 @interface GralWindow: NSWindow<NSWindowDelegate> {
 @public
 	struct gral_window_interface const *interface;
 	void *user_data;
+	int redraw_merge_threshold;
+	int render_threads;
+	CVDisplayLinkRef display_link;
+	struct frame_callback_data *frame_callbacks;
+	int is_frame_pending;
+	BOOL is_closed;
 }
 @end
 @implementation GralWindow
@@ -558,7 +1302,22 @@ static int get_modifiers(NSEventModifierFlags modifier_flags) {
 - (void)windowDidResignKey:(NSNotification *)notification {
 	interface->focus_leave(user_data);
 }
+- (void)windowWillClose:(NSNotification *)notification {
+	// this waits for a running display link callback, so no frame is scheduled for the window after it is closed
+	is_closed = YES;
+	if (display_link) {
+		CVDisplayLinkStop(display_link);
+	}
+}
 - (void)dealloc {
+	if (display_link) {
+		CVDisplayLinkRelease(display_link);
+	}
+	while (frame_callbacks) {
+		struct frame_callback_data *next = frame_callbacks->next;
+		free(frame_callbacks);
+		frame_callbacks = next;
+	}
 	interface->destroy(user_data);
 	[super dealloc];
 }
@@ -569,8 +1328,34 @@ static int get_modifiers(NSEventModifierFlags modifier_flags) {
 	struct gral_window_interface const *interface;
 	void *user_data;
 	BOOL is_pointer_locked;
+	CGContextRef backing;
+	CGRect *backing_damage;
+	int backing_damage_count;
 }
 @end
+static int get_rect_area(CGRect rect) {
+	return (int)(rect.size.width * rect.size.height);
+}
+static int merge_rects(CGRect *rects, int count, int threshold) {
+	// merge two rects if they overlap or if their union repaints at most threshold additional pixels
+	BOOL has_merged = YES;
+	while (has_merged) {
+		has_merged = NO;
+		for (int i = 0; i < count; i++) {
+			for (int j = i + 1; j < count; j++) {
+				CGRect union_rect = CGRectUnion(rects[i], rects[j]);
+				if (CGRectIntersectsRect(rects[i], rects[j]) || get_rect_area(union_rect) - get_rect_area(rects[i]) - get_rect_area(rects[j]) <= threshold) {
+					rects[i] = union_rect;
+					rects[j] = rects[count - 1];
+					count--;
+					j = i;
+					has_merged = YES;
+				}
+			}
+		}
+	}
+	return count;
+}
 @implementation GralView
 - (BOOL)acceptsFirstResponder {
 	return YES;
@@ -578,9 +1363,142 @@ static int get_modifiers(NSEventModifierFlags modifier_flags) {
 - (BOOL)isFlipped {
 	return YES;
 }
+static void draw_view(GralView *view, CGContextRef context, CGRect const *dirty_rects, int dirty_count, CGRect rect) {
+	int threshold = ((GralWindow *)[view window])->redraw_merge_threshold;
+	if (threshold == INT_MAX || dirty_count <= 1) {
+		view->interface->draw((struct gral_draw_context *)context, rect.origin.x, rect.origin.y, rect.size.width, rect.size.height, view->user_data);
+	}
+	else {
+		// call draw once per disjoint dirty rect instead of once for their bounding box
+		CGRect *rects = malloc(dirty_count * sizeof(CGRect));
+		for (int i = 0; i < dirty_count; i++) {
+			rects[i] = CGRectIntegral(dirty_rects[i]);
+		}
+		int count = merge_rects(rects, dirty_count, threshold);
+		for (int i = 0; i < count; i++) {
+			CGContextSaveGState(context);
+			CGContextClipToRect(context, rects[i]);
+			view->interface->draw((struct gral_draw_context *)context, rects[i].origin.x, rects[i].origin.y, rects[i].size.width, rects[i].size.height, view->user_data);
+			CGContextRestoreGState(context);
+		}
+		free(rects);
+	}
+	// the contexts are reused, so culling enabled during this draw must not carry over to the next one
+	set_culling_margin(context, NULL);
+}
+static void add_backing_damage(GralView *view, CGRect rect) {
+	if (CGRectIsEmpty(rect)) {
+		return;
+	}
+	// many small rects are not worth tracking individually, so they collapse into their bounding box
+	if (view->backing_damage_count >= 32) {
+		for (int i = 1; i < view->backing_damage_count; i++) {
+			view->backing_damage[0] = CGRectUnion(view->backing_damage[0], view->backing_damage[i]);
+		}
+		view->backing_damage_count = 1;
+	}
+	view->backing_damage = realloc(view->backing_damage, (view->backing_damage_count + 1) * sizeof(CGRect));
+	view->backing_damage[view->backing_damage_count++] = rect;
+}
+static void subtract_backing_damage(GralView *view, CGRect rect) {
+	// every damaged rect that overlaps is split into the up to four parts around the overlap
+	CGRect *rects = malloc(view->backing_damage_count * 4 * sizeof(CGRect));
+	int count = 0;
+	for (int i = 0; i < view->backing_damage_count; i++) {
+		CGRect damage = view->backing_damage[i];
+		CGRect overlap = CGRectIntersection(damage, rect);
+		if (CGRectIsEmpty(overlap)) {
+			rects[count++] = damage;
+			continue;
+		}
+		CGRect parts[4] = {
+			CGRectMake(damage.origin.x, damage.origin.y, damage.size.width, CGRectGetMinY(overlap) - CGRectGetMinY(damage)),
+			CGRectMake(damage.origin.x, CGRectGetMaxY(overlap), damage.size.width, CGRectGetMaxY(damage) - CGRectGetMaxY(overlap)),
+			CGRectMake(damage.origin.x, overlap.origin.y, CGRectGetMinX(overlap) - CGRectGetMinX(damage), overlap.size.height),
+			CGRectMake(CGRectGetMaxX(overlap), overlap.origin.y, CGRectGetMaxX(damage) - CGRectGetMaxX(overlap), overlap.size.height)
+		};
+		for (int j = 0; j < 4; j++) {
+			if (!CGRectIsEmpty(parts[j])) {
+				rects[count++] = parts[j];
+			}
+		}
+	}
+	free(view->backing_damage);
+	view->backing_damage = rects;
+	view->backing_damage_count = count;
+}
+static BOOL ensure_backing(GralView *view) {
+	// the backing context is created by the first scroll and recreated whenever the size or scale of the view changes
+	CGRect bounds = NSRectToCGRect([view bounds]);
+	int scale = (int)[[view window] backingScaleFactor];
+	size_t width = (size_t)bounds.size.width * scale;
+	size_t height = (size_t)bounds.size.height * scale;
+	if (view->backing) {
+		if (CGBitmapContextGetWidth(view->backing) == width && CGBitmapContextGetHeight(view->backing) == height) {
+			return YES;
+		}
+		CGContextRelease(view->backing);
+	}
+	CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
+	view->backing = CGBitmapContextCreate(NULL, width, height, 8, 0, color_space, kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst);
+	CGColorSpaceRelease(color_space);
+	// use the same flipped coordinate system as the view
+	CGContextTranslateCTM(view->backing, 0.0f, height);
+	CGContextScaleCTM(view->backing, scale, -scale);
+	view->backing_damage_count = 0;
+	add_backing_damage(view, bounds);
+	return NO;
+}
+static void draw_retained(GralView *view, CGContextRef context) {
+	// render only the damaged parts of the backing context and copy it to the view
+	ensure_backing(view);
+	if (view->backing_damage_count > 0) {
+		CGRect *rects = view->backing_damage;
+		int count = view->backing_damage_count;
+		view->backing_damage = NULL;
+		view->backing_damage_count = 0;
+		CGRect rect = rects[0];
+		for (int i = 1; i < count; i++) {
+			rect = CGRectUnion(rect, rects[i]);
+		}
+		CGContextSaveGState(view->backing);
+		CGContextClipToRects(view->backing, rects, count);
+		draw_view(view, view->backing, rects, count, rect);
+		CGContextRestoreGState(view->backing);
+		free(rects);
+	}
+	CGImageRef image = CGBitmapContextCreateImage(view->backing);
+	CGRect bounds = NSRectToCGRect([view bounds]);
+	CGContextSaveGState(context);
+	CGContextTranslateCTM(context, 0.0f, bounds.size.height);
+	CGContextScaleCTM(context, 1.0f, -1.0f);
+	CGContextDrawImage(context, CGRectMake(0.0f, 0.0f, bounds.size.width, bounds.size.height), image);
+	CGContextRestoreGState(context);
+	CGImageRelease(image);
+}
 - (void)drawRect:(NSRect)rect {
 	CGContextRef context = [[NSGraphicsContext currentContext] CGContext];
-	interface->draw((struct gral_draw_context *)context, rect.origin.x, rect.origin.y, rect.size.width, rect.size.height, user_data);
+	CFAbsoluteTime draw_start = CFAbsoluteTimeGetCurrent();
+	if (backing) {
+		draw_retained(self, context);
+	}
+	else {
+		NSRect const *dirty_rects;
+		NSInteger dirty_count;
+		[self getRectsBeingDrawn:&dirty_rects count:&dirty_count];
+		CGRect *rects = malloc(dirty_count * sizeof(CGRect));
+		for (NSInteger i = 0; i < dirty_count; i++) {
+			rects[i] = NSRectToCGRect(dirty_rects[i]);
+		}
+		draw_view(self, context, rects, (int)dirty_count, NSRectToCGRect(rect));
+		free(rects);
+	}
+	count_frame(CFAbsoluteTimeGetCurrent() - draw_start);
+}
+- (void)dealloc {
+	CGContextRelease(backing);
+	free(backing_damage);
+	[super dealloc];
 }
 - (void)setFrameSize:(NSSize)size {
 	[super setFrameSize:size];
@@ -754,17 +1672,38 @@ struct gral_window *gral_window_create(struct gral_application *application, int
 	];
 	window->interface = interface;
 	window->user_data = user_data;
+	window->redraw_merge_threshold = INT_MAX;
+	window->render_threads = 1;
+	window->display_link = NULL;
+	window->frame_callbacks = NULL;
+	window->is_frame_pending = 0;
+	window->is_closed = NO;
 	[window setDelegate:window];
 	[window setTitle:[NSString stringWithUTF8String:title]];
 	return (struct gral_window *)window;
 }
 
+static void update_render_threads(GralWindow *window) {
+	// Core Animation records the drawing of an asynchronous layer and rasterizes it on its own threads
+	NSView *view = [window contentView];
+	if (window->render_threads > 1) {
+		[view setWantsLayer:YES];
+		[[view layer] setDrawsAsynchronously:YES];
+	}
+	else {
+		[[view layer] setDrawsAsynchronously:NO];
+	}
+}
+
 void gral_window_show(struct gral_window *window_) {
 	GralWindow *window = (GralWindow *)window_;
 	GralView *view = [[GralView alloc] init];
 	view->interface = window->interface;
 	view->user_data = window->user_data;
 	view->is_pointer_locked = NO;
+	view->backing = NULL;
+	view->backing_damage = NULL;
+	view->backing_damage_count = 0;
 	NSTrackingArea *trackingArea = [[NSTrackingArea alloc]
 		initWithRect:NSZeroRect
 		options:NSTrackingMouseEnteredAndExited|NSTrackingMouseMoved|NSTrackingActiveAlways|NSTrackingInVisibleRect
@@ -775,6 +1714,7 @@ void gral_window_show(struct gral_window *window_) {
 	[trackingArea release];
 	[window setContentView:view];
 	[view release];
+	update_render_threads(window);
 	[window makeKeyAndOrderFront:nil];
 }
 
@@ -783,13 +1723,167 @@ void gral_window_set_title(struct gral_window *window, char const *title) {
 }
 
 void gral_window_request_redraw(struct gral_window *window, int x, int y, int width, int height) {
-	[[(GralWindow *)window contentView] setNeedsDisplayInRect:NSMakeRect(x, y, width, height)];
+	NSView *view = [(GralWindow *)window contentView];
+	if ([view isKindOfClass:[GralView class]] && ((GralView *)view)->backing) {
+		add_backing_damage((GralView *)view, CGRectMake(x, y, width, height));
+	}
+	[view setNeedsDisplayInRect:NSMakeRect(x, y, width, height)];
+}
+
+static void move_backing_pixels(CGContextRef backing, CGRect destination, int scale, int dx, int dy) {
+	// the source and the destination overlap, so the rows are moved in the direction of the scroll
+	unsigned char *data = CGBitmapContextGetData(backing);
+	size_t stride = CGBitmapContextGetBytesPerRow(backing);
+	int x = (int)destination.origin.x * scale;
+	int y = (int)destination.origin.y * scale;
+	int rows = (int)destination.size.height * scale;
+	size_t row_size = (size_t)destination.size.width * scale * 4;
+	for (int i = 0; i < rows; i++) {
+		int row = dy > 0 ? rows - 1 - i : i;
+		unsigned char *destination_row = data + (y + row) * stride + x * 4;
+		unsigned char *source_row = destination_row - dy * scale * (ptrdiff_t)stride - dx * scale * 4;
+		memmove(destination_row, source_row, row_size);
+	}
+}
+
+void gral_window_scroll(struct gral_window *window, int dx, int dy, int x, int y, int width, int height) {
+	NSView *content_view = [(GralWindow *)window contentView];
+	if (![content_view isKindOfClass:[GralView class]]) {
+		[content_view setNeedsDisplay:YES];
+		return;
+	}
+	GralView *view = (GralView *)content_view;
+	// AppKit no longer copies the pixels of layer-backed views, so scrolling moves the pixels of a retained backing context instead
+	if (!ensure_backing(view)) {
+		[view setNeedsDisplay:YES];
+		return;
+	}
+	CGRect rectangle = CGRectIntersection(CGRectMake(x, y, width, height), NSRectToCGRect([view bounds]));
+	if (CGRectIsEmpty(rectangle)) {
+		return;
+	}
+	// the pixels that stay inside of the rectangle are moved, everything else is exposed
+	CGRect destination = CGRectIntersection(CGRectOffset(rectangle, dx, dy), rectangle);
+	if (!CGRectIsEmpty(destination)) {
+		move_backing_pixels(view->backing, destination, (int)[(GralWindow *)window backingScaleFactor], dx, dy);
+	}
+	// damage that has not been rendered yet moves along with the pixels
+	CGRect *moved_damage = malloc((view->backing_damage_count + 1) * sizeof(CGRect));
+	int moved_count = 0;
+	for (int i = 0; i < view->backing_damage_count; i++) {
+		CGRect moved = CGRectIntersection(CGRectOffset(CGRectIntersection(view->backing_damage[i], rectangle), dx, dy), destination);
+		if (!CGRectIsEmpty(moved)) {
+			moved_damage[moved_count++] = moved;
+		}
+	}
+	add_backing_damage(view, rectangle);
+	if (!CGRectIsEmpty(destination)) {
+		subtract_backing_damage(view, destination);
+	}
+	for (int i = 0; i < moved_count; i++) {
+		add_backing_damage(view, moved_damage[i]);
+	}
+	free(moved_damage);
+	[view setNeedsDisplayInRect:NSRectFromCGRect(rectangle)];
+}
+
+struct frame_event {
+	GralWindow *window;
+	double presentation_time;
+	double frame_interval;
+};
+
+static void run_frame_callbacks(void *user_data) {
+	struct frame_event *event = user_data;
+	GralWindow *window = event->window;
+	// callbacks that request the next frame are added to a new list
+	struct frame_callback_data *callbacks = window->frame_callbacks;
+	window->frame_callbacks = NULL;
+	__atomic_store_n(&window->is_frame_pending, 0, __ATOMIC_RELEASE);
+	while (callbacks) {
+		struct frame_callback_data *next = callbacks->next;
+		if (!window->is_closed) {
+			callbacks->callback(event->presentation_time, event->frame_interval, callbacks->user_data);
+		}
+		free(callbacks);
+		callbacks = next;
+	}
+	if (window->frame_callbacks == NULL && !window->is_closed) {
+		CVDisplayLinkStop(window->display_link);
+	}
+	[window release];
+	free(event);
+}
+
+static CVReturn display_link_callback(CVDisplayLinkRef display_link, CVTimeStamp const *now, CVTimeStamp const *output_time, CVOptionFlags flags_in, CVOptionFlags *flags_out, void *context) {
+	// this runs on a Core Video thread, so the frame is only announced to the main thread if the previous one has been handled there
+	GralWindow *window = context;
+	if (__atomic_exchange_n(&window->is_frame_pending, 1, __ATOMIC_ACQ_REL)) {
+		return kCVReturnSuccess;
+	}
+	struct frame_event *event = malloc(sizeof(struct frame_event));
+	event->window = [window retain];
+	// the host time is converted relative to the current time, since gral_time_get_monotonic uses a different clock
+	event->presentation_time = gral_time_get_monotonic() + ((double)output_time->hostTime - (double)CVGetCurrentHostTime()) / CVGetHostClockFrequency();
+	if (output_time->videoRefreshPeriod > 0 && output_time->videoTimeScale > 0) {
+		event->frame_interval = (double)output_time->videoRefreshPeriod / output_time->videoTimeScale;
+	}
+	else {
+		event->frame_interval = CVDisplayLinkGetActualOutputVideoRefreshPeriod(display_link);
+	}
+	GralCallbackObject *callback_object = [[GralCallbackObject alloc] init];
+	callback_object->callback = &run_frame_callbacks;
+	callback_object->user_data = event;
+	[callback_object performSelectorOnMainThread:@selector(invoke:) withObject:nil waitUntilDone:NO];
+	[callback_object release];
+	return kCVReturnSuccess;
+}
+
+void gral_window_request_frame(struct gral_window *window_, void (*callback)(double presentation_time, double frame_interval, void *user_data), void *user_data) {
+	GralWindow *window = (GralWindow *)window_;
+	if (window->is_closed) {
+		return;
+	}
+	struct frame_callback_data *callback_data = malloc(sizeof(struct frame_callback_data));
+	callback_data->callback = callback;
+	callback_data->user_data = user_data;
+	// keep the callbacks in the order in which they were requested
+	callback_data->next = NULL;
+	struct frame_callback_data **link = &window->frame_callbacks;
+	while (*link) {
+		link = &(*link)->next;
+	}
+	*link = callback_data;
+	if (window->display_link == NULL) {
+		CVDisplayLinkCreateWithActiveCGDisplays(&window->display_link);
+		CVDisplayLinkSetOutputCallback(window->display_link, &display_link_callback, window);
+	}
+	if (!CVDisplayLinkIsRunning(window->display_link)) {
+		// follow the display that the window is currently on
+		NSNumber *screen_number = [[[window screen] deviceDescription] objectForKey:@"NSScreenNumber"];
+		if (screen_number) {
+			CVDisplayLinkSetCurrentCGDisplay(window->display_link, [screen_number unsignedIntValue]);
+		}
+		CVDisplayLinkStart(window->display_link);
+	}
 }
 
 void gral_window_set_minimum_size(struct gral_window *window, int minimum_width, int minimum_height) {
 	[(GralWindow *)window setContentMinSize:NSMakeSize(minimum_width, minimum_height)];
 }
 
+void gral_window_set_redraw_merge_threshold(struct gral_window *window, int threshold) {
+	((GralWindow *)window)->redraw_merge_threshold = threshold;
+}
+
+void gral_window_set_render_threads(struct gral_window *window_, int threads) {
+	GralWindow *window = (GralWindow *)window_;
+	window->render_threads = threads;
+	if ([[window contentView] isKindOfClass:[GralView class]]) {
+		update_render_threads(window);
+	}
+}
+
 static NSCursor *get_cursor(int cursor) {
 	static NSCursor *transparent_cursor = NULL;
 	switch (cursor) {
@@ -23,10 +23,13 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <mmdeviceapi.h>
 #include <rtworkq.h>
 #include <audioclient.h>
+#include <dwmapi.h>
 #include <roapi.h>
 #include <windows.foundation.h>
 #include <windows.devices.enumeration.h>
 #include <windows.devices.midi.h>
+#include <limits.h>
+#include <math.h>
 
 template <class T> class ComPointer {
 	T *pointer;
@@ -277,26 +280,85 @@ static DWORD main_thread_id;
 static int window_count = 0;
 
 struct gral_draw_context {
-	ID2D1HwndRenderTarget *target;
+	ID2D1RenderTarget *target;
 	ID2D1PathGeometry *path;
 	ID2D1GeometrySink *sink;
 	bool open;
-	gral_draw_context(): open(false) {}
+	ComPointer<IWICBitmap> bitmap; // only for headless draw contexts
+	D2D1_RECT_F clip_bounds; // in target coordinates, without the transform
+	bool culling;
+	float culling_margin;
+	gral_draw_context(): open(false), clip_bounds(D2D1::InfiniteRect()), culling(false), culling_margin(0.0f) {}
+};
+
+#define MIPMAP_MAX_LEVELS 16
+struct Mipmap {
+	int width;
+	int height;
+	UINT32 *data; // premultiplied BGRA
 };
 
 struct gral_image {
 	int width;
 	int height;
+	int stride;
+	int format;
 	void *data;
-	gral_image(int width, int height, void *data): width(width), height(height), data(data) {}
+	void (*release)(void *data, void *user_data);
+	void *user_data;
+	bool is_read_only;
+	int mipmap_count;
+	Mipmap mipmaps[MIPMAP_MAX_LEVELS]; // mipmaps[0] is half the size of the image
+	gral_image(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data, bool is_read_only): width(width), height(height), stride(stride), format(format), data(data), release(release), user_data(user_data), is_read_only(is_read_only), mipmap_count(0) {}
 };
 
 struct gral_text {
 	ComPointer<IDWriteTextLayout> layout;
 	Buffer<wchar_t> utf16;
-	gral_text(Buffer<wchar_t> const &utf16): utf16(utf16) {}
+	bool is_shared;
+	gral_text(Buffer<wchar_t> const &utf16): utf16(utf16), is_shared(false) {}
 };
 
+struct gral_path {
+	ComPointer<ID2D1PathGeometry> geometry;
+	ComPointer<ID2D1GeometrySink> sink;
+	D2D1_POINT_2F current_point;
+	bool open;
+	gral_path(): open(false) {}
+};
+
+static gral_draw_statistics draw_statistics;
+static gral_draw_statistics reset_draw_statistics;
+static SRWLOCK draw_statistics_lock = SRWLOCK_INIT;
+
+static void count_draw_statistic(size_t *counter, size_t value) {
+	InterlockedExchangeAddSizeT(counter, value);
+}
+
+static size_t load_draw_statistic(size_t *counter) {
+	return InterlockedExchangeAddSizeT(counter, 0);
+}
+
+static void get_draw_statistics(gral_draw_statistics *statistics) {
+	statistics->frames = load_draw_statistic(&draw_statistics.frames);
+	statistics->paths = load_draw_statistic(&draw_statistics.paths);
+	statistics->fills = load_draw_statistic(&draw_statistics.fills);
+	statistics->strokes = load_draw_statistic(&draw_statistics.strokes);
+	statistics->text_runs = load_draw_statistic(&draw_statistics.text_runs);
+	statistics->images = load_draw_statistic(&draw_statistics.images);
+	statistics->converted_bytes = load_draw_statistic(&draw_statistics.converted_bytes);
+	statistics->draw_time = draw_statistics.draw_time;
+	statistics->flush_time = draw_statistics.flush_time;
+}
+
+static void count_frame(double draw_time, double flush_time) {
+	AcquireSRWLockExclusive(&draw_statistics_lock);
+	count_draw_statistic(&draw_statistics.frames, 1);
+	draw_statistics.draw_time += draw_time;
+	draw_statistics.flush_time += flush_time;
+	ReleaseSRWLockExclusive(&draw_statistics_lock);
+}
+
 static void adjust_window_size(int &width, int &height) {
 	RECT rect;
 	rect.left = 0;
@@ -317,9 +379,58 @@ struct WindowData {
 	HCURSOR cursor;
 	bool is_pointer_locked;
 	POINT locked_pointer;
-	WindowData(): mouse_inside(false), minimum_width(0), minimum_height(0), is_pointer_locked(false) {}
+	int redraw_merge_threshold;
+	WindowData(): mouse_inside(false), minimum_width(0), minimum_height(0), is_pointer_locked(false), redraw_merge_threshold(INT_MAX) {}
 };
 
+static int get_rect_area(RECT const &rect) {
+	return (rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+static int merge_rects(RECT *rects, int count, int threshold) {
+	// merge two rects if they overlap or if their union repaints at most threshold additional pixels
+	bool has_merged = true;
+	while (has_merged) {
+		has_merged = false;
+		for (int i = 0; i < count; i++) {
+			for (int j = i + 1; j < count; j++) {
+				RECT union_rect, intersection;
+				UnionRect(&union_rect, &rects[i], &rects[j]);
+				if (IntersectRect(&intersection, &rects[i], &rects[j]) || get_rect_area(union_rect) - get_rect_area(rects[i]) - get_rect_area(rects[j]) <= threshold) {
+					rects[i] = union_rect;
+					rects[j] = rects[count - 1];
+					count--;
+					j = i;
+					has_merged = true;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+static int get_dirty_rects(HWND hwnd, int threshold, Buffer<RECT> &rects) {
+	// the update region is split into disjoint rects unless the threshold asks for the bounding box
+	if (threshold != INT_MAX) {
+		HRGN region = CreateRectRgn(0, 0, 0, 0);
+		GetUpdateRgn(hwnd, region, FALSE);
+		DWORD size = GetRegionData(region, 0, NULL);
+		Buffer<char> buffer(size);
+		RGNDATA *data = (RGNDATA *)(char *)buffer;
+		int count = size > 0 && GetRegionData(region, size, data) ? (int)data->rdh.nCount : 0;
+		DeleteObject(region);
+		if (count > 1) {
+			rects = Buffer<RECT>(count);
+			for (int i = 0; i < count; i++) {
+				rects[i] = ((RECT *)data->Buffer)[i];
+			}
+			return merge_rects(rects, count, threshold);
+		}
+	}
+	GetUpdateRect(hwnd, &rects[0], FALSE);
+	return 1;
+}
+
 struct gral_timer {
 	void (*callback)(void *user_data);
 	void *user_data;
@@ -406,19 +517,29 @@ static LRESULT CALLBACK window_procedure(HWND hwnd, UINT uMsg, WPARAM wParam, LP
 				D2D1_SIZE_U size = D2D1::SizeU(rc.right - rc.left, rc.bottom - rc.top);
 				factory->CreateHwndRenderTarget(D2D1::RenderTargetProperties(), D2D1::HwndRenderTargetProperties(hwnd, size, D2D1_PRESENT_OPTIONS_RETAIN_CONTENTS), &window_data->target);
 			}
-			RECT update_rect;
-			GetUpdateRect(hwnd, &update_rect, FALSE);
+			Buffer<RECT> update_rects(1);
+			int update_rect_count = get_dirty_rects(hwnd, window_data->redraw_merge_threshold, update_rects);
 			gral_draw_context draw_context;
 			draw_context.target = window_data->target;
 			factory->CreatePathGeometry(&draw_context.path);
 			draw_context.path->Open(&draw_context.sink);
 			draw_context.sink->SetFillMode(D2D1_FILL_MODE_WINDING);
+			double draw_start = gral_time_get_monotonic();
 			draw_context.target->BeginDraw();
-			draw_context.target->PushAxisAlignedClip(D2D1::RectF((FLOAT)update_rect.left, (FLOAT)update_rect.top, (FLOAT)update_rect.right, (FLOAT)update_rect.bottom), D2D1_ANTIALIAS_MODE_ALIASED);
-			draw_context.target->Clear(D2D1::ColorF(D2D1::ColorF::White));
-			window_data->iface->draw(&draw_context, update_rect.left, update_rect.top, update_rect.right - update_rect.left, update_rect.bottom - update_rect.top, window_data->user_data);
-			draw_context.target->PopAxisAlignedClip();
-			if (draw_context.target->EndDraw() == D2DERR_RECREATE_TARGET) {
+			for (int i = 0; i < update_rect_count; i++) {
+				RECT const &update_rect = update_rects[i];
+				draw_context.clip_bounds = D2D1::RectF((FLOAT)update_rect.left, (FLOAT)update_rect.top, (FLOAT)update_rect.right, (FLOAT)update_rect.bottom);
+				draw_context.target->PushAxisAlignedClip(draw_context.clip_bounds, D2D1_ANTIALIAS_MODE_ALIASED);
+				draw_context.target->Clear(D2D1::ColorF(D2D1::ColorF::White));
+				window_data->iface->draw(&draw_context, update_rect.left, update_rect.top, update_rect.right - update_rect.left, update_rect.bottom - update_rect.top, window_data->user_data);
+				draw_context.target->PopAxisAlignedClip();
+			}
+			// Direct2D batches the drawing commands and submits them in EndDraw, which is counted as flush time
+			double flush_start = gral_time_get_monotonic();
+			HRESULT result = draw_context.target->EndDraw();
+			double flush_end = gral_time_get_monotonic();
+			count_frame(flush_start - draw_start, flush_end - flush_start);
+			if (result == D2DERR_RECREATE_TARGET) {
 				draw_context.target->Release();
 				window_data->target = NULL;
 			}
@@ -633,14 +754,18 @@ static LRESULT CALLBACK window_procedure(HWND hwnd, UINT uMsg, WPARAM wParam, LP
 	}
 }
 
-gral_application *gral_application_create(char const *id, gral_application_interface const *iface, void *user_data) {
-	hInstance = GetModuleHandle(NULL);
-	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
-	RoInitialize(RO_INIT_SINGLETHREADED);
+static void create_factories() {
 	D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &factory);
 	factory->CreateStrokeStyle(D2D1::StrokeStyleProperties(D2D1_CAP_STYLE_ROUND, D2D1_CAP_STYLE_ROUND, D2D1_CAP_STYLE_ROUND, D2D1_LINE_JOIN_ROUND), NULL, 0, &stroke_style);
 	CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&imaging_factory));
 	DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory), (IUnknown **)&dwrite_factory);
+}
+
+gral_application *gral_application_create(char const *id, gral_application_interface const *iface, void *user_data) {
+	hInstance = GetModuleHandle(NULL);
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+	RoInitialize(RO_INIT_SINGLETHREADED);
+	create_factories();
 	WNDCLASS window_class;
 	window_class.style = CS_DBLCLKS;
 	window_class.lpfnWndProc = &window_procedure;
@@ -814,15 +939,131 @@ public:
 	}
 };
 
+static void image_free_data(void *data, void *user_data) {
+	gral_memory_free(data);
+}
+
+static void premultiply_row(BYTE const *source, BYTE *destination, int width) {
+	for (int x = 0; x < width; x++) {
+		UINT a = source[3];
+		destination[0] = (BYTE)((source[2] * a + 127) / 255);
+		destination[1] = (BYTE)((source[1] * a + 127) / 255);
+		destination[2] = (BYTE)((source[0] * a + 127) / 255);
+		destination[3] = (BYTE)a;
+		source += 4;
+		destination += 4;
+	}
+}
+
+static UINT32 average_pixels(UINT32 a, UINT32 b, UINT32 c, UINT32 d) {
+	// average the four channels in two 16-bit lanes at a time
+	UINT32 low = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF) + 0x00020002;
+	UINT32 high = (a >> 8 & 0x00FF00FF) + (b >> 8 & 0x00FF00FF) + (c >> 8 & 0x00FF00FF) + (d >> 8 & 0x00FF00FF) + 0x00020002;
+	return (low >> 2 & 0x00FF00FF) | (high >> 2 & 0x00FF00FF) << 8;
+}
+
+static Mipmap downsample(UINT32 const *source_data, int source_stride, int source_width, int source_height) {
+	// halve the size with a 2x2 box filter, odd sizes are rounded up and the last column and row are repeated
+	Mipmap mipmap;
+	mipmap.width = (source_width + 1) / 2;
+	mipmap.height = (source_height + 1) / 2;
+	mipmap.data = new UINT32[mipmap.width * mipmap.height];
+	for (int y = 0; y < mipmap.height; y++) {
+		UINT32 const *row0 = (UINT32 const *)((BYTE const *)source_data + y * 2 * source_stride);
+		UINT32 const *row1 = (UINT32 const *)((BYTE const *)source_data + min(y * 2 + 1, source_height - 1) * source_stride);
+		UINT32 *row = mipmap.data + y * mipmap.width;
+		for (int x = 0; x < mipmap.width; x++) {
+			int x1 = min(x * 2 + 1, source_width - 1);
+			row[x] = average_pixels(row0[x * 2], row0[x1], row1[x * 2], row1[x1]);
+		}
+	}
+	return mipmap;
+}
+
+static SRWLOCK mipmaps_lock = SRWLOCK_INIT;
+
+static void delete_mipmaps(gral_image *image) {
+	for (int i = 0; i < image->mipmap_count; i++) {
+		delete[] image->mipmaps[i].data;
+	}
+	image->mipmap_count = 0;
+}
+
+static void add_mipmap(gral_image *image) {
+	if (image->mipmap_count > 0) {
+		Mipmap const &source = image->mipmaps[image->mipmap_count - 1];
+		image->mipmaps[image->mipmap_count++] = downsample(source.data, source.width * 4, source.width, source.height);
+	}
+	else if (image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA) {
+		image->mipmaps[image->mipmap_count++] = downsample((UINT32 const *)image->data, image->stride, image->width, image->height);
+	}
+	else {
+		// the levels are averaged in premultiplied BGRA, so straight RGBA images are converted first
+		Buffer<UINT32> premultiplied(image->width * image->height);
+		for (int y = 0; y < image->height; y++) {
+			premultiply_row((BYTE const *)image->data + y * image->stride, (BYTE *)(premultiplied + y * image->width), image->width);
+		}
+		image->mipmaps[image->mipmap_count++] = downsample(premultiplied, image->width * 4, image->width, image->height);
+	}
+}
+
 gral_image *gral_image_create(int width, int height, void *data) {
-	return new gral_image(width, height, data);
+	return new gral_image(width, height, width * 4, GRAL_PIXEL_FORMAT_RGBA, data, &image_free_data, NULL, false);
+}
+
+gral_image *gral_image_create_from_data(int width, int height, int stride, int format, void *data, void (*release)(void *data, void *user_data), void *user_data) {
+	// the data may be read-only, so images created from it are never updated
+	return new gral_image(width, height, stride, format, data, release, user_data, true);
 }
 
 void gral_image_delete(gral_image *image) {
-	gral_memory_free(image->data);
+	if (image->release) {
+		image->release(image->data, image->user_data);
+	}
+	delete_mipmaps(image);
 	delete image;
 }
 
+void gral_image_update(gral_image *image, int x, int y, int width, int height, void const *data) {
+	if (image->is_read_only) {
+		return;
+	}
+	// only the part of the rectangle that lies within the image is updated
+	int source_stride = width * 4;
+	BYTE const *source_data = (BYTE const *)data;
+	if (x < 0) {
+		source_data -= x * 4;
+		width += x;
+		x = 0;
+	}
+	if (y < 0) {
+		source_data -= y * source_stride;
+		height += y;
+		y = 0;
+	}
+	width = min(width, image->width - x);
+	height = min(height, image->height - y);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+	if (image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA) {
+		count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	}
+	for (int i = 0; i < height; i++) {
+		BYTE *destination = (BYTE *)image->data + (y + i) * image->stride + x * 4;
+		BYTE const *source = source_data + i * source_stride;
+		if (image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA) {
+			premultiply_row(source, destination, width);
+		}
+		else {
+			CopyMemory(destination, source, width * 4);
+		}
+	}
+	AcquireSRWLockExclusive(&mipmaps_lock);
+	delete_mipmaps(image);
+	ReleaseSRWLockExclusive(&mipmaps_lock);
+}
+
 static gral_font *create_font(WCHAR const *name, float size) {
 	WCHAR locale_name[LOCALE_NAME_MAX_LENGTH];
 	GetUserDefaultLocaleName(locale_name, LOCALE_NAME_MAX_LENGTH);
@@ -871,10 +1112,138 @@ void gral_font_get_metrics(gral_window *window, gral_font *font, float *ascent,
 	if (descent) *descent = (float)metrics.descent / (float)metrics.designUnitsPerEm * format->GetFontSize();
 }
 
+struct TextCacheEntry {
+	ComPointer<IDWriteTextFormat> format;
+	Buffer<wchar_t> utf16;
+	ComPointer<IDWriteTextLayout> layout;
+	UINT32 hash;
+	TextCacheEntry *bucket_next;
+	TextCacheEntry *previous;
+	TextCacheEntry *next;
+	TextCacheEntry(Buffer<wchar_t> const &utf16, UINT32 hash): utf16(utf16), hash(hash), bucket_next(NULL), previous(NULL), next(NULL) {}
+};
+static struct {
+	int capacity;
+	int count;
+	TextCacheEntry **buckets;
+	UINT32 bucket_count;
+	TextCacheEntry *head;
+	TextCacheEntry *tail;
+	size_t hits;
+	size_t misses;
+} text_cache;
+
+static UINT32 get_text_hash(IDWriteTextFormat *format, Buffer<wchar_t> const &utf16) {
+	// FNV-1a over the format pointer and the UTF-16 code units
+	UINT32 hash = 2166136261u;
+	UINT_PTR format_bits = (UINT_PTR)format;
+	for (size_t i = 0; i < sizeof(UINT_PTR); i++) {
+		hash = (hash ^ (UINT32)((format_bits >> (i * 8)) & 0xFF)) * 16777619u;
+	}
+	for (size_t i = 0; i < utf16.get_length(); i++) {
+		hash = (hash ^ (UINT32)utf16[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static bool is_text_equal(TextCacheEntry const *entry, IDWriteTextFormat *format, Buffer<wchar_t> const &utf16) {
+	if (entry->format != format || entry->utf16.get_length() != utf16.get_length()) {
+		return false;
+	}
+	return memcmp(entry->utf16, utf16, utf16.get_length() * sizeof(wchar_t)) == 0;
+}
+
+static void text_cache_unlink(TextCacheEntry *entry) {
+	if (entry->previous) {
+		entry->previous->next = entry->next;
+	}
+	else {
+		text_cache.head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->previous = entry->previous;
+	}
+	else {
+		text_cache.tail = entry->previous;
+	}
+}
+
+static void text_cache_push_head(TextCacheEntry *entry) {
+	entry->previous = NULL;
+	entry->next = text_cache.head;
+	if (text_cache.head) {
+		text_cache.head->previous = entry;
+	}
+	else {
+		text_cache.tail = entry;
+	}
+	text_cache.head = entry;
+}
+
+static void text_cache_evict(int capacity) {
+	while (text_cache.count > capacity) {
+		TextCacheEntry *entry = text_cache.tail;
+		text_cache_unlink(entry);
+		TextCacheEntry **link = &text_cache.buckets[entry->hash & (text_cache.bucket_count - 1)];
+		while (*link != entry) {
+			link = &(*link)->bucket_next;
+		}
+		*link = entry->bucket_next;
+		text_cache.count--;
+		delete entry;
+	}
+}
+
+static void create_layout(gral_text *text, IDWriteTextFormat *format) {
+	dwrite_factory->CreateTextLayout(text->utf16, (UINT32)text->utf16.get_length(), format, 1.0e30f, 1.0e30f, &text->layout);
+}
+
+static IDWriteTextLayout *get_attributes_layout(gral_text *text) {
+	if (text->is_shared) {
+		// the layout is shared with the cache, so the attributes are set on a new layout with the same format
+		ComPointer<IDWriteTextLayout> shared_layout = text->layout;
+		text->layout = ComPointer<IDWriteTextLayout>();
+		create_layout(text, shared_layout);
+		text->is_shared = false;
+	}
+	return text->layout;
+}
+
 gral_text *gral_text_create(gral_window *window, char const *utf8, gral_font *font) {
 	IDWriteTextFormat *format = (IDWriteTextFormat *)font;
 	gral_text *text = new gral_text(utf8_to_utf16(utf8));
-	dwrite_factory->CreateTextLayout(text->utf16, (UINT32)text->utf16.get_length(), format, 1.0e30f, 1.0e30f, &text->layout);
+	if (text_cache.capacity == 0) {
+		create_layout(text, format);
+		return text;
+	}
+	// look up an already created layout with the same text and format, which DirectWrite shapes only once
+	UINT32 hash = get_text_hash(format, text->utf16);
+	TextCacheEntry **bucket = &text_cache.buckets[hash & (text_cache.bucket_count - 1)];
+	TextCacheEntry *entry = *bucket;
+	while (entry && !(entry->hash == hash && is_text_equal(entry, format, text->utf16))) {
+		entry = entry->bucket_next;
+	}
+	if (entry) {
+		text_cache_unlink(entry);
+		text_cache_push_head(entry);
+		text_cache.hits++;
+	}
+	else {
+		entry = new TextCacheEntry(text->utf16, hash);
+		// the format is kept alive so that its address cannot be reused by another format
+		format->AddRef();
+		*&entry->format = format;
+		create_layout(text, format);
+		entry->layout = text->layout;
+		entry->bucket_next = *bucket;
+		*bucket = entry;
+		text_cache_push_head(entry);
+		text_cache.count++;
+		text_cache.misses++;
+		text_cache_evict(text_cache.capacity);
+	}
+	text->layout = entry->layout;
+	text->is_shared = true;
 	return text;
 }
 
@@ -886,14 +1255,14 @@ void gral_text_set_bold(gral_text *text, int start_index, int end_index) {
 	DWRITE_TEXT_RANGE range;
 	range.startPosition = utf8_index_to_utf16(text->utf16, start_index);
 	range.length = utf8_index_to_utf16(text->utf16, end_index) - range.startPosition;
-	text->layout->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, range);
+	get_attributes_layout(text)->SetFontWeight(DWRITE_FONT_WEIGHT_BOLD, range);
 }
 
 void gral_text_set_italic(gral_text *text, int start_index, int end_index) {
 	DWRITE_TEXT_RANGE range;
 	range.startPosition = utf8_index_to_utf16(text->utf16, start_index);
 	range.length = utf8_index_to_utf16(text->utf16, end_index) - range.startPosition;
-	text->layout->SetFontStyle(DWRITE_FONT_STYLE_ITALIC, range);
+	get_attributes_layout(text)->SetFontStyle(DWRITE_FONT_STYLE_ITALIC, range);
 }
 
 void gral_text_set_color(gral_text *text, int start_index, int end_index, float red, float green, float blue, float alpha) {
@@ -902,7 +1271,20 @@ void gral_text_set_color(gral_text *text, int start_index, int end_index, float
 	range.length = utf8_index_to_utf16(text->utf16, end_index) - range.startPosition;
 	ComPointer<GralColorDrawingEffect> drawing_effect;
 	*&drawing_effect = new GralColorDrawingEffect(D2D1::ColorF(red, green, blue, alpha));
-	text->layout->SetDrawingEffect(drawing_effect, range);
+	get_attributes_layout(text)->SetDrawingEffect(drawing_effect, range);
+}
+
+void gral_text_set_spans(gral_text *text, gral_text_span const *spans, int count) {
+	for (int i = 0; i < count; i++) {
+		gral_text_span const *span = &spans[i];
+		if (span->style & GRAL_TEXT_STYLE_BOLD) {
+			gral_text_set_bold(text, span->start_index, span->end_index);
+		}
+		if (span->style & GRAL_TEXT_STYLE_ITALIC) {
+			gral_text_set_italic(text, span->start_index, span->end_index);
+		}
+		gral_text_set_color(text, span->start_index, span->end_index, span->red, span->green, span->blue, span->alpha);
+	}
 }
 
 float gral_text_get_width(gral_text *text) {
@@ -925,18 +1307,420 @@ int gral_text_x_to_index(gral_text *text, float x) {
 	return utf16_index_to_utf8(text->utf16, inside && trailing ? metrics.textPosition + metrics.length : metrics.textPosition);
 }
 
-void gral_draw_context_draw_image(gral_draw_context *draw_context, gral_image *image, float x, float y) {
+void gral_text_cache_set_capacity(int capacity) {
+	text_cache_evict(capacity);
+	// the entries are never more than the capacity, so the bucket count only changes here
+	UINT32 bucket_count = 1;
+	while ((int)bucket_count < capacity) {
+		bucket_count *= 2;
+	}
+	if (bucket_count != text_cache.bucket_count) {
+		TextCacheEntry **buckets = new TextCacheEntry *[bucket_count];
+		for (UINT32 i = 0; i < bucket_count; i++) {
+			buckets[i] = NULL;
+		}
+		for (TextCacheEntry *entry = text_cache.head; entry; entry = entry->next) {
+			TextCacheEntry **bucket = &buckets[entry->hash & (bucket_count - 1)];
+			entry->bucket_next = *bucket;
+			*bucket = entry;
+		}
+		delete[] text_cache.buckets;
+		text_cache.buckets = buckets;
+		text_cache.bucket_count = bucket_count;
+	}
+	text_cache.capacity = capacity;
+}
+
+void gral_text_cache_get_statistics(size_t *hits, size_t *misses) {
+	if (hits) *hits = text_cache.hits;
+	if (misses) *misses = text_cache.misses;
+}
+
+gral_path *gral_path_create() {
+	return new gral_path();
+}
+
+void gral_path_delete(gral_path *path) {
+	delete path;
+}
+
+static void open_path(gral_path *path) {
+	if (path->sink) {
+		return;
+	}
+	// a closed geometry cannot be extended, so copy it into a new one
+	ComPointer<ID2D1PathGeometry> geometry;
+	factory->CreatePathGeometry(&geometry);
+	geometry->Open(&path->sink);
+	path->sink->SetFillMode(D2D1_FILL_MODE_WINDING);
+	if (path->geometry) {
+		path->geometry->Stream(path->sink);
+	}
+	path->geometry = geometry;
+	if (path->open) {
+		path->sink->BeginFigure(path->current_point, D2D1_FIGURE_BEGIN_FILLED);
+	}
+}
+
+static void close_path(gral_path *path) {
+	if (!path->sink) {
+		return;
+	}
+	if (path->open) {
+		path->sink->EndFigure(D2D1_FIGURE_END_OPEN);
+	}
+	path->sink->Close();
+	path->sink = ComPointer<ID2D1GeometrySink>();
+}
+
+void gral_path_close_path(gral_path *path) {
+	open_path(path);
+	path->sink->EndFigure(D2D1_FIGURE_END_CLOSED);
+	path->open = false;
+}
+
+void gral_path_move_to(gral_path *path, float x, float y) {
+	open_path(path);
+	path->current_point = D2D1::Point2F(x, y);
+	if (path->open) {
+		path->sink->EndFigure(D2D1_FIGURE_END_OPEN);
+	}
+	path->sink->BeginFigure(path->current_point, D2D1_FIGURE_BEGIN_FILLED);
+	path->open = true;
+}
+
+void gral_path_line_to(gral_path *path, float x, float y) {
+	open_path(path);
+	path->current_point = D2D1::Point2F(x, y);
+	path->sink->AddLine(path->current_point);
+}
+
+void gral_path_curve_to(gral_path *path, float x1, float y1, float x2, float y2, float x, float y) {
+	open_path(path);
+	path->current_point = D2D1::Point2F(x, y);
+	path->sink->AddBezier(D2D1::BezierSegment(D2D1::Point2F(x1, y1), D2D1::Point2F(x2, y2), path->current_point));
+}
+
+#define SAMPLE_PYRAMID_FACTOR 8
+#define SAMPLE_PYRAMID_MAX_LEVELS 10
+struct SamplePyramidLevel {
+	float *minimum;
+	float *maximum;
+};
+struct gral_sample_pyramid {
+	int level_count;
+	SamplePyramidLevel levels[SAMPLE_PYRAMID_MAX_LEVELS];
+	gral_sample_pyramid(): level_count(0) {}
+};
+
+static void get_min_max(float const *minimum, float const *maximum, int count, float &min_value, float &max_value) {
+	for (int i = 0; i < count; i++) {
+		min_value = min(min_value, minimum[i]);
+		max_value = max(max_value, maximum[i]);
+	}
+}
+
+gral_sample_pyramid *gral_sample_pyramid_create(float const *samples, int count) {
+	// level n stores the minimum and maximum of blocks of SAMPLE_PYRAMID_FACTOR^(n+1) samples
+	gral_sample_pyramid *pyramid = new gral_sample_pyramid();
+	float const *minimum = samples;
+	float const *maximum = samples;
+	while (count > SAMPLE_PYRAMID_FACTOR && pyramid->level_count < SAMPLE_PYRAMID_MAX_LEVELS) {
+		int block_count = (count + SAMPLE_PYRAMID_FACTOR - 1) / SAMPLE_PYRAMID_FACTOR;
+		SamplePyramidLevel &level = pyramid->levels[pyramid->level_count];
+		level.minimum = new float[block_count];
+		level.maximum = new float[block_count];
+		for (int i = 0; i < block_count; i++) {
+			int start = i * SAMPLE_PYRAMID_FACTOR;
+			level.minimum[i] = minimum[start];
+			level.maximum[i] = maximum[start];
+			get_min_max(minimum + start, maximum + start, min(SAMPLE_PYRAMID_FACTOR, count - start), level.minimum[i], level.maximum[i]);
+		}
+		minimum = level.minimum;
+		maximum = level.maximum;
+		count = block_count;
+		pyramid->level_count++;
+	}
+	return pyramid;
+}
+
+void gral_sample_pyramid_delete(gral_sample_pyramid *pyramid) {
+	for (int i = 0; i < pyramid->level_count; i++) {
+		delete[] pyramid->levels[i].minimum;
+		delete[] pyramid->levels[i].maximum;
+	}
+	delete pyramid;
+}
+
+static void get_samples_min_max(float const *samples, gral_sample_pyramid const *pyramid, int start, int end, float &min_value, float &max_value) {
+	// use the coarsest level that covers at least two whole blocks and scan the remainders on both sides with finer levels
+	int level = -1;
+	int block_size = 1;
+	if (pyramid) {
+		while (level + 1 < pyramid->level_count && end - start >= block_size * SAMPLE_PYRAMID_FACTOR * 2) {
+			level++;
+			block_size *= SAMPLE_PYRAMID_FACTOR;
+		}
+	}
+	if (level < 0) {
+		get_min_max(samples + start, samples + start, end - start, min_value, max_value);
+		return;
+	}
+	int first_block = (start + block_size - 1) / block_size;
+	int last_block = end / block_size;
+	get_min_max(pyramid->levels[level].minimum + first_block, pyramid->levels[level].maximum + first_block, last_block - first_block, min_value, max_value);
+	get_samples_min_max(samples, pyramid, start, first_block * block_size, min_value, max_value);
+	get_samples_min_max(samples, pyramid, last_block * block_size, end, min_value, max_value);
+}
+
+struct gral_layer {
+	int width;
+	int height;
+	ComPointer<ID2D1RenderTarget> parent_target;
+	ComPointer<ID2D1BitmapRenderTarget> target;
+	bool is_valid;
+	gral_layer(int width, int height): width(width), height(height), is_valid(false) {}
+};
+
+gral_layer *gral_layer_create(int width, int height) {
+	return new gral_layer(width, height);
+}
+
+void gral_layer_delete(gral_layer *layer) {
+	delete layer;
+}
+
+void gral_layer_invalidate(gral_layer *layer) {
+	layer->is_valid = false;
+}
+
+gral_draw_context *gral_draw_context_create(int width, int height) {
+	if (factory == NULL) {
+		// headless drawing does not require an application
+		CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+		create_factories();
+	}
+	gral_draw_context *draw_context = new gral_draw_context();
+	imaging_factory->CreateBitmap(width, height, GUID_WICPixelFormat32bppPBGRA, WICBitmapCacheOnLoad, &draw_context->bitmap);
+	ID2D1RenderTarget *target;
+	factory->CreateWicBitmapRenderTarget(draw_context->bitmap, D2D1::RenderTargetProperties(), &target);
+	draw_context->target = target;
+	draw_context->clip_bounds = D2D1::RectF(0.0f, 0.0f, (FLOAT)width, (FLOAT)height);
+	factory->CreatePathGeometry(&draw_context->path);
+	draw_context->path->Open(&draw_context->sink);
+	draw_context->sink->SetFillMode(D2D1_FILL_MODE_WINDING);
+	draw_context->target->BeginDraw();
+	return draw_context;
+}
+
+void gral_draw_context_delete(gral_draw_context *draw_context) {
+	draw_context->target->EndDraw();
+	draw_context->sink->Release();
+	draw_context->path->Release();
+	draw_context->target->Release();
+	delete draw_context;
+}
+
+void gral_draw_context_get_pixels(gral_draw_context *draw_context, void *data) {
+	draw_context->target->EndDraw();
+	UINT width, height;
+	draw_context->bitmap->GetSize(&width, &height);
+	draw_context->bitmap->CopyPixels(NULL, width * 4, width * height * 4, (BYTE *)data);
+	count_draw_statistic(&draw_statistics.converted_bytes, (size_t)width * height * 4);
+	BYTE *pixels = (BYTE *)data;
+	for (UINT i = 0; i < width * height; i++) {
+		// premultiplied BGRA -> RGBA
+		BYTE *pixel = pixels + i * 4;
+		UINT a = pixel[3];
+		BYTE b = a == 0 ? 0 : (pixel[0] * 255 + a / 2) / a;
+		BYTE g = a == 0 ? 0 : (pixel[1] * 255 + a / 2) / a;
+		BYTE r = a == 0 ? 0 : (pixel[2] * 255 + a / 2) / a;
+		pixel[0] = r;
+		pixel[1] = g;
+		pixel[2] = b;
+	}
+	draw_context->target->BeginDraw();
+}
+
+static ComPointer<ID2D1Bitmap> create_bitmap(gral_draw_context *draw_context, gral_image *image) {
 	ComPointer<IWICBitmap> source_bitmap;
-	imaging_factory->CreateBitmapFromMemory(image->width, image->height, GUID_WICPixelFormat32bppRGBA, image->width * 4, image->width * image->height * 4, (PBYTE)image->data, &source_bitmap);
+	REFWICPixelFormatGUID pixel_format = image->format == GRAL_PIXEL_FORMAT_PREMULTIPLIED_BGRA ? GUID_WICPixelFormat32bppPBGRA : GUID_WICPixelFormat32bppRGBA;
+	imaging_factory->CreateBitmapFromMemory(image->width, image->height, pixel_format, image->stride, image->stride * image->height, (PBYTE)image->data, &source_bitmap);
 	ComPointer<IWICFormatConverter> format_converter;
 	imaging_factory->CreateFormatConverter(&format_converter);
 	format_converter->Initialize(source_bitmap, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom);
 	ComPointer<ID2D1Bitmap> bitmap;
 	draw_context->target->CreateBitmapFromWicBitmap(format_converter, &bitmap);
+	return bitmap;
+}
+
+void gral_draw_context_draw_image(gral_draw_context *draw_context, gral_image *image, float x, float y) {
+	count_draw_statistic(&draw_statistics.images, 1);
+	ComPointer<ID2D1Bitmap> bitmap = create_bitmap(draw_context, image);
 	draw_context->target->DrawBitmap(bitmap, D2D1::RectF(x, y, x + image->width, y + image->height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, D2D1::RectF(0.0f, 0.0f, (FLOAT)image->width, (FLOAT)image->height));
 }
 
+static ComPointer<ID2D1Bitmap> create_mipmap_bitmap(gral_draw_context *draw_context, gral_image *image, int &level) {
+	// the levels are computed on first use and live as long as the image is not updated
+	AcquireSRWLockExclusive(&mipmaps_lock);
+	while (image->mipmap_count < level && image->mipmap_count < MIPMAP_MAX_LEVELS) {
+		Mipmap const *source = image->mipmap_count > 0 ? &image->mipmaps[image->mipmap_count - 1] : NULL;
+		if (source ? source->width == 1 && source->height == 1 : image->width == 1 && image->height == 1) {
+			break;
+		}
+		add_mipmap(image);
+	}
+	level = min(level, image->mipmap_count);
+	ComPointer<ID2D1Bitmap> bitmap;
+	if (level > 0) {
+		Mipmap const &mipmap = image->mipmaps[level - 1];
+		draw_context->target->CreateBitmap(D2D1::SizeU(mipmap.width, mipmap.height), mipmap.data, mipmap.width * 4, D2D1::BitmapProperties(D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)), &bitmap);
+	}
+	ReleaseSRWLockExclusive(&mipmaps_lock);
+	return level > 0 ? bitmap : create_bitmap(draw_context, image);
+}
+
+void gral_draw_context_draw_image_scaled(gral_draw_context *draw_context, gral_image *image, float source_x, float source_y, float source_width, float source_height, float x, float y, float width, float height, int filter) {
+	if (source_width <= 0.0f || source_height <= 0.0f || width <= 0.0f || height <= 0.0f) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	int level = 0;
+	if (filter == GRAL_IMAGE_FILTER_SMOOTH) {
+		// pick the mipmap level that is scaled down by less than a factor of two in device space
+		D2D1_MATRIX_3X2_F transform;
+		draw_context->target->GetTransform(&transform);
+		float scale = max(hypotf(transform._11, transform._12) * width / source_width, hypotf(transform._21, transform._22) * height / source_height);
+		while (scale <= 0.5f && level < MIPMAP_MAX_LEVELS) {
+			level++;
+			scale *= 2.0f;
+		}
+	}
+	ComPointer<ID2D1Bitmap> bitmap = create_mipmap_bitmap(draw_context, image, level);
+	// every pixel of a level covers exactly 2^level pixels of the image, only the last row and column can extend past it
+	float factor = ldexpf(1.0f, -level);
+	D2D1_BITMAP_INTERPOLATION_MODE interpolation_mode = filter == GRAL_IMAGE_FILTER_NEAREST ? D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR : D2D1_BITMAP_INTERPOLATION_MODE_LINEAR;
+	draw_context->target->DrawBitmap(bitmap, D2D1::RectF(x, y, x + width, y + height), 1.0f, interpolation_mode, D2D1::RectF(source_x * factor, source_y * factor, (source_x + source_width) * factor, (source_y + source_height) * factor));
+}
+
+void gral_draw_context_draw_sprites(gral_draw_context *draw_context, gral_image *image, gral_sprite const *sprites, int count, int tinted) {
+	count_draw_statistic(&draw_statistics.images, count);
+	ComPointer<ID2D1Bitmap> bitmap = create_bitmap(draw_context, image);
+	ComPointer<ID2D1SolidColorBrush> brush;
+	D2D1_ANTIALIAS_MODE antialias_mode = draw_context->target->GetAntialiasMode();
+	if (tinted) {
+		draw_context->target->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f), &brush);
+		// FillOpacityMask requires aliased rendering
+		draw_context->target->SetAntialiasMode(D2D1_ANTIALIAS_MODE_ALIASED);
+	}
+	for (int i = 0; i < count; i++) {
+		gral_sprite const *sprite = &sprites[i];
+		D2D1_RECT_F destination = D2D1::RectF(sprite->x, sprite->y, sprite->x + sprite->width, sprite->y + sprite->height);
+		D2D1_RECT_F source = D2D1::RectF(sprite->source_x, sprite->source_y, sprite->source_x + sprite->width, sprite->source_y + sprite->height);
+		if (tinted) {
+			brush->SetColor(D2D1::ColorF(sprite->red, sprite->green, sprite->blue, sprite->alpha));
+			draw_context->target->FillOpacityMask(bitmap, brush, D2D1_OPACITY_MASK_CONTENT_GRAPHICS, destination, source);
+		}
+		else {
+			draw_context->target->DrawBitmap(bitmap, destination, sprite->alpha, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, source);
+		}
+	}
+	draw_context->target->SetAntialiasMode(antialias_mode);
+}
+
+void gral_draw_context_draw_layer(gral_draw_context *draw_context, gral_layer *layer, float x, float y, void (*callback)(gral_draw_context *draw_context, void *user_data), void *user_data) {
+	if (layer->parent_target != draw_context->target) {
+		// the bitmap of a compatible render target can only be drawn by the target that created it
+		layer->parent_target = ComPointer<ID2D1RenderTarget>();
+		layer->target = ComPointer<ID2D1BitmapRenderTarget>();
+		draw_context->target->AddRef();
+		*&layer->parent_target = draw_context->target;
+		draw_context->target->CreateCompatibleRenderTarget(D2D1::SizeF((FLOAT)layer->width, (FLOAT)layer->height), &layer->target);
+		layer->is_valid = false;
+	}
+	if (!layer->is_valid) {
+		gral_draw_context layer_context;
+		layer_context.target = layer->target;
+		layer_context.clip_bounds = D2D1::RectF(0.0f, 0.0f, (FLOAT)layer->width, (FLOAT)layer->height);
+		factory->CreatePathGeometry(&layer_context.path);
+		layer_context.path->Open(&layer_context.sink);
+		layer_context.sink->SetFillMode(D2D1_FILL_MODE_WINDING);
+		layer_context.target->BeginDraw();
+		layer_context.target->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+		callback(&layer_context, user_data);
+		layer_context.target->EndDraw();
+		layer_context.sink->Release();
+		layer_context.path->Release();
+		layer->is_valid = true;
+	}
+	count_draw_statistic(&draw_statistics.images, 1);
+	ComPointer<ID2D1Bitmap> bitmap;
+	layer->target->GetBitmap(&bitmap);
+	draw_context->target->DrawBitmap(bitmap, D2D1::RectF(x, y, x + layer->width, y + layer->height), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, D2D1::RectF(0.0f, 0.0f, (FLOAT)layer->width, (FLOAT)layer->height));
+}
+
+static bool is_rectangle_visible(gral_draw_context *draw_context, float x1, float y1, float x2, float y2) {
+	// the transformed bounding box is compared, so this is conservative under rotations
+	D2D1::Matrix3x2F transform;
+	draw_context->target->GetTransform(&transform);
+	D2D1_POINT_2F corners[4] = {
+		transform.TransformPoint(D2D1::Point2F(x1, y1)),
+		transform.TransformPoint(D2D1::Point2F(x2, y1)),
+		transform.TransformPoint(D2D1::Point2F(x1, y2)),
+		transform.TransformPoint(D2D1::Point2F(x2, y2))
+	};
+	D2D1_RECT_F bounds = D2D1::RectF(corners[0].x, corners[0].y, corners[0].x, corners[0].y);
+	for (int i = 1; i < 4; i++) {
+		bounds.left = min(bounds.left, corners[i].x);
+		bounds.top = min(bounds.top, corners[i].y);
+		bounds.right = max(bounds.right, corners[i].x);
+		bounds.bottom = max(bounds.bottom, corners[i].y);
+	}
+	D2D1_RECT_F const &clip = draw_context->clip_bounds;
+	return bounds.left <= clip.right && bounds.right >= clip.left && bounds.top <= clip.bottom && bounds.bottom >= clip.top;
+}
+
+static bool is_culled(gral_draw_context *draw_context, float x1, float y1, float x2, float y2) {
+	if (!draw_context->culling) {
+		return false;
+	}
+	float margin = draw_context->culling_margin;
+	return !is_rectangle_visible(draw_context, x1 - margin, y1 - margin, x2 + margin, y2 + margin);
+}
+
+static bool is_text_culled(gral_draw_context *draw_context, gral_text *text, float x, float y) {
+	if (!draw_context->culling) {
+		return false;
+	}
+	DWRITE_LINE_METRICS line_metrics;
+	UINT32 count = 1;
+	text->layout->GetLineMetrics(&line_metrics, count, &count);
+	DWRITE_TEXT_METRICS metrics;
+	text->layout->GetMetrics(&metrics);
+	// the layout box is as wide as the advances, one line height on each side covers glyphs that overhang it
+	float top = y - line_metrics.baseline + metrics.top;
+	return is_culled(draw_context, x + metrics.left - metrics.height, top - metrics.height, x + metrics.left + metrics.widthIncludingTrailingWhitespace + metrics.height, top + 2.0f * metrics.height);
+}
+
+static bool is_points_culled(gral_draw_context *draw_context, gral_point const *points, int count) {
+	if (!draw_context->culling) {
+		return false;
+	}
+	float x1 = points[0].x, y1 = points[0].y, x2 = points[0].x, y2 = points[0].y;
+	for (int i = 1; i < count; i++) {
+		x1 = min(x1, points[i].x);
+		y1 = min(y1, points[i].y);
+		x2 = max(x2, points[i].x);
+		y2 = max(y2, points[i].y);
+	}
+	return is_culled(draw_context, x1, y1, x2, y2);
+}
+
 void gral_draw_context_draw_text(gral_draw_context *draw_context, gral_text *text, float x, float y, float red, float green, float blue, float alpha) {
+	if (is_text_culled(draw_context, text, x, y)) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.text_runs, 1);
 	DWRITE_LINE_METRICS line_metrics;
 	UINT32 count = 1;
 	text->layout->GetLineMetrics(&line_metrics, count, &count);
@@ -947,7 +1731,29 @@ void gral_draw_context_draw_text(gral_draw_context *draw_context, gral_text *tex
 	text->layout->Draw(draw_context, renderer, x, y-line_metrics.baseline);
 }
 
+void gral_draw_context_draw_text_batch(gral_draw_context *draw_context, gral_text_run const *runs, int count) {
+	count_draw_statistic(&draw_statistics.text_runs, count);
+	// share one brush and one renderer between all runs
+	ComPointer<ID2D1SolidColorBrush> brush;
+	draw_context->target->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f), &brush);
+	ComPointer<GralTextRenderer> renderer;
+	*&renderer = new GralTextRenderer(brush);
+	for (int i = 0; i < count; i++) {
+		if (is_text_culled(draw_context, runs[i].text, runs[i].x, runs[i].y)) {
+			continue;
+		}
+		DWRITE_LINE_METRICS line_metrics;
+		UINT32 line_count = 1;
+		runs[i].text->layout->GetLineMetrics(&line_metrics, line_count, &line_count);
+		brush->SetColor(D2D1::ColorF(runs[i].red, runs[i].green, runs[i].blue, runs[i].alpha));
+		runs[i].text->layout->Draw(draw_context, renderer, runs[i].x, runs[i].y-line_metrics.baseline);
+	}
+}
+
 void gral_draw_context_add_text(gral_draw_context *draw_context, gral_text *text, float x, float y) {
+	if (is_text_culled(draw_context, text, x, y)) {
+		return;
+	}
 	DWRITE_LINE_METRICS line_metrics;
 	UINT32 count = 1;
 	text->layout->GetLineMetrics(&line_metrics, count, &count);
@@ -957,12 +1763,34 @@ void gral_draw_context_add_text(gral_draw_context *draw_context, gral_text *text
 	text->layout->Draw(draw_context, renderer, x, y-line_metrics.baseline);
 }
 
+void gral_draw_context_add_path(gral_draw_context *draw_context, gral_path *path) {
+	close_path(path);
+	if (!path->geometry) {
+		return;
+	}
+	if (draw_context->culling) {
+		D2D1_RECT_F bounds;
+		path->geometry->GetBounds(NULL, &bounds);
+		if (bounds.left > bounds.right || is_culled(draw_context, bounds.left, bounds.top, bounds.right, bounds.bottom)) {
+			return;
+		}
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	if (draw_context->open) {
+		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
+		draw_context->open = false;
+	}
+	path->geometry->Stream(draw_context->sink);
+}
+
 void gral_draw_context_close_path(gral_draw_context *draw_context) {
 	draw_context->sink->EndFigure(D2D1_FIGURE_END_CLOSED);
 	draw_context->open = false;
 }
 
 void gral_draw_context_move_to(gral_draw_context *draw_context, float x, float y) {
+	// add_polyline, add_curves and add_samples start their path here as well
+	count_draw_statistic(&draw_statistics.paths, 1);
 	D2D1_POINT_2F point = D2D1::Point2F(x, y);
 	if (draw_context->open) {
 		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
@@ -981,6 +1809,85 @@ void gral_draw_context_curve_to(gral_draw_context *draw_context, float x1, float
 	draw_context->sink->AddBezier(D2D1::BezierSegment(D2D1::Point2F(x1, y1), D2D1::Point2F(x2, y2), point));
 }
 
+void gral_draw_context_add_polyline(gral_draw_context *draw_context, gral_point const *points, int count, int closed) {
+	if (count < 1 || is_points_culled(draw_context, points, count)) {
+		return;
+	}
+	gral_draw_context_move_to(draw_context, points[0].x, points[0].y);
+	Buffer<D2D1_POINT_2F> d2d_points(count - 1);
+	for (int i = 1; i < count; i++) {
+		d2d_points[i - 1] = D2D1::Point2F(points[i].x, points[i].y);
+	}
+	draw_context->sink->AddLines(d2d_points, count - 1);
+	if (closed) {
+		gral_draw_context_close_path(draw_context);
+	}
+}
+
+void gral_draw_context_add_curves(gral_draw_context *draw_context, gral_point const *points, int count, int closed) {
+	if (count < 1 || is_points_culled(draw_context, points, count)) {
+		return;
+	}
+	gral_draw_context_move_to(draw_context, points[0].x, points[0].y);
+	int curve_count = (count - 1) / 3;
+	Buffer<D2D1_BEZIER_SEGMENT> segments(curve_count);
+	for (int i = 0; i < curve_count; i++) {
+		gral_point const *p = points + 1 + i * 3;
+		segments[i] = D2D1::BezierSegment(D2D1::Point2F(p[0].x, p[0].y), D2D1::Point2F(p[1].x, p[1].y), D2D1::Point2F(p[2].x, p[2].y));
+	}
+	draw_context->sink->AddBeziers(segments, curve_count);
+	if (closed) {
+		gral_draw_context_close_path(draw_context);
+	}
+}
+
+void gral_draw_context_add_samples(gral_draw_context *draw_context, float const *samples, int count, gral_sample_pyramid *pyramid, float x, float y, float x_scale, float y_scale) {
+	if (count < 1) {
+		return;
+	}
+	gral_draw_context_move_to(draw_context, x, y + samples[0] * y_scale);
+	// the pixel columns are in physical pixels, so the DPI of the target is taken into account
+	D2D1_MATRIX_3X2_F transform;
+	draw_context->target->GetTransform(&transform);
+	FLOAT dpi_x, dpi_y;
+	draw_context->target->GetDpi(&dpi_x, &dpi_y);
+	double dx = x_scale * transform._11 * dpi_x / 96.0;
+	if (transform._12 != 0.0f || transform._21 != 0.0f || x_scale <= 0.0f || dx <= 0.0 || dx > 0.25) {
+		Buffer<D2D1_POINT_2F> points(count - 1);
+		for (int i = 1; i < count; i++) {
+			points[i - 1] = D2D1::Point2F(x + (float)((double)i * x_scale), y + samples[i] * y_scale);
+		}
+		draw_context->sink->AddLines(points, count - 1);
+		return;
+	}
+	// reduce the samples of every device pixel column to its first, minimum, maximum and last value, which rasterizes identically
+	double device_x = (x * transform._11 + transform._31) * dpi_x / 96.0;
+	Buffer<D2D1_POINT_2F> points(1024);
+	UINT32 point_count = 0;
+	int i = 0;
+	while (i < count) {
+		double column = floor(device_x + i * dx);
+		int next = (int)min(ceil((column + 1.0 - device_x) / dx), (double)count);
+		if (next <= i) {
+			next = i + 1;
+		}
+		float min_sample = samples[i];
+		float max_sample = samples[i];
+		get_samples_min_max(samples, pyramid, i, next, min_sample, max_sample);
+		if (point_count + 4 > points.get_length()) {
+			draw_context->sink->AddLines(points, point_count);
+			point_count = 0;
+		}
+		FLOAT column_x = x + (float)((double)i * x_scale);
+		points[point_count++] = D2D1::Point2F(column_x, y + samples[i] * y_scale);
+		points[point_count++] = D2D1::Point2F(column_x, y + min_sample * y_scale);
+		points[point_count++] = D2D1::Point2F(column_x, y + max_sample * y_scale);
+		points[point_count++] = D2D1::Point2F(x + (float)((double)(next - 1) * x_scale), y + samples[next - 1] * y_scale);
+		i = next;
+	}
+	draw_context->sink->AddLines(points, point_count);
+}
+
 static ComPointer<ID2D1LinearGradientBrush> create_linear_gradient_brush(gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, gral_gradient_stop const *stops, int count) {
 	Buffer<D2D1_GRADIENT_STOP> gradient_stops(count);
 	for (int i = 0; i < count; i++) {
@@ -995,6 +1902,7 @@ static ComPointer<ID2D1LinearGradientBrush> create_linear_gradient_brush(gral_dr
 }
 
 void gral_draw_context_fill(gral_draw_context *draw_context, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.fills, 1);
 	if (draw_context->open) {
 		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
 		draw_context->open = false;
@@ -1012,7 +1920,46 @@ void gral_draw_context_fill(gral_draw_context *draw_context, float red, float gr
 	draw_context->sink->SetFillMode(D2D1_FILL_MODE_WINDING);
 }
 
+void gral_draw_context_fill_rectangles(gral_draw_context *draw_context, gral_rectangle const *rectangles, int count, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.fills, 1);
+	ComPointer<ID2D1SolidColorBrush> brush;
+	draw_context->target->CreateSolidColorBrush(D2D1::ColorF(red, green, blue, alpha), &brush);
+	for (int i = 0; i < count; i++) {
+		draw_context->target->FillRectangle(D2D1::RectF(rectangles[i].x, rectangles[i].y, rectangles[i].x + rectangles[i].width, rectangles[i].y + rectangles[i].height), brush);
+	}
+}
+
+void gral_draw_context_fill_colored_rectangles(gral_draw_context *draw_context, gral_colored_rectangle const *rectangles, int count) {
+	count_draw_statistic(&draw_statistics.fills, 1);
+	ComPointer<ID2D1SolidColorBrush> brush;
+	draw_context->target->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f), &brush);
+	for (int i = 0; i < count; i++) {
+		brush->SetColor(D2D1::ColorF(rectangles[i].red, rectangles[i].green, rectangles[i].blue, rectangles[i].alpha));
+		draw_context->target->FillRectangle(D2D1::RectF(rectangles[i].x, rectangles[i].y, rectangles[i].x + rectangles[i].width, rectangles[i].y + rectangles[i].height), brush);
+	}
+}
+
+void gral_draw_context_fill_path_instances(gral_draw_context *draw_context, gral_path *path, gral_path_instance const *instances, int count) {
+	close_path(path);
+	if (!path->geometry) {
+		return;
+	}
+	count_draw_statistic(&draw_statistics.paths, 1);
+	count_draw_statistic(&draw_statistics.fills, count);
+	ComPointer<ID2D1SolidColorBrush> brush;
+	draw_context->target->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f), &brush);
+	D2D1::Matrix3x2F transform;
+	draw_context->target->GetTransform(&transform);
+	for (int i = 0; i < count; i++) {
+		draw_context->target->SetTransform(D2D1::Matrix3x2F::Translation(instances[i].x, instances[i].y) * transform);
+		brush->SetColor(D2D1::ColorF(instances[i].red, instances[i].green, instances[i].blue, instances[i].alpha));
+		draw_context->target->FillGeometry(path->geometry, brush);
+	}
+	draw_context->target->SetTransform(transform);
+}
+
 void gral_draw_context_fill_linear_gradient(gral_draw_context *draw_context, float start_x, float start_y, float end_x, float end_y, gral_gradient_stop const *stops, int count) {
+	count_draw_statistic(&draw_statistics.fills, 1);
 	if (draw_context->open) {
 		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
 		draw_context->open = false;
@@ -1030,6 +1977,7 @@ void gral_draw_context_fill_linear_gradient(gral_draw_context *draw_context, flo
 }
 
 void gral_draw_context_stroke(gral_draw_context *draw_context, float line_width, float red, float green, float blue, float alpha) {
+	count_draw_statistic(&draw_statistics.strokes, 1);
 	if (draw_context->open) {
 		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
 		draw_context->open = false;
@@ -1048,6 +1996,7 @@ void gral_draw_context_stroke(gral_draw_context *draw_context, float line_width,
 }
 
 void gral_draw_context_stroke_linear_gradient(gral_draw_context *draw_context, float line_width, float start_x, float start_y, float end_x, float end_y, gral_gradient_stop const *stops, int count) {
+	count_draw_statistic(&draw_statistics.strokes, 1);
 	if (draw_context->open) {
 		draw_context->sink->EndFigure(D2D1_FIGURE_END_OPEN);
 		draw_context->open = false;
@@ -1074,6 +2023,12 @@ void gral_draw_context_draw_clipped(gral_draw_context *draw_context, void (*call
 	ComPointer<ID2D1Layer> layer;
 	draw_context->target->CreateLayer(&layer);
 	draw_context->target->PushLayer(D2D1::LayerParameters(D2D1::InfiniteRect(), draw_context->path), layer);
+	D2D1_RECT_F clip_bounds = draw_context->clip_bounds;
+	D2D1::Matrix3x2F transform;
+	draw_context->target->GetTransform(&transform);
+	D2D1_RECT_F path_bounds;
+	draw_context->path->GetBounds(transform, &path_bounds);
+	draw_context->clip_bounds = D2D1::RectF(max(clip_bounds.left, path_bounds.left), max(clip_bounds.top, path_bounds.top), min(clip_bounds.right, path_bounds.right), min(clip_bounds.bottom, path_bounds.bottom));
 
 	draw_context->sink->Release();
 	draw_context->path->Release();
@@ -1084,6 +2039,7 @@ void gral_draw_context_draw_clipped(gral_draw_context *draw_context, void (*call
 	callback(draw_context, user_data);
 
 	draw_context->target->PopLayer();
+	draw_context->clip_bounds = clip_bounds;
 }
 
 void gral_draw_context_draw_transformed(gral_draw_context *draw_context, float a, float b, float c, float d, float e, float f, void (*callback)(gral_draw_context *draw_context, void *user_data), void *user_data) {
@@ -1094,6 +2050,37 @@ void gral_draw_context_draw_transformed(gral_draw_context *draw_context, float a
 	draw_context->target->SetTransform(matrix);
 }
 
+int gral_draw_context_is_rectangle_visible(gral_draw_context *draw_context, float x, float y, float width, float height) {
+	return is_rectangle_visible(draw_context, x, y, x + width, y + height);
+}
+
+void gral_draw_context_set_culling(gral_draw_context *draw_context, int enabled, float margin) {
+	draw_context->culling = enabled != 0;
+	draw_context->culling_margin = margin;
+}
+
+void gral_draw_statistics_get(gral_draw_statistics *statistics) {
+	gral_draw_statistics current;
+	AcquireSRWLockExclusive(&draw_statistics_lock);
+	get_draw_statistics(&current);
+	statistics->frames = current.frames - reset_draw_statistics.frames;
+	statistics->paths = current.paths - reset_draw_statistics.paths;
+	statistics->fills = current.fills - reset_draw_statistics.fills;
+	statistics->strokes = current.strokes - reset_draw_statistics.strokes;
+	statistics->text_runs = current.text_runs - reset_draw_statistics.text_runs;
+	statistics->images = current.images - reset_draw_statistics.images;
+	statistics->converted_bytes = current.converted_bytes - reset_draw_statistics.converted_bytes;
+	statistics->draw_time = current.draw_time - reset_draw_statistics.draw_time;
+	statistics->flush_time = current.flush_time - reset_draw_statistics.flush_time;
+	ReleaseSRWLockExclusive(&draw_statistics_lock);
+}
+
+void gral_draw_statistics_reset() {
+	AcquireSRWLockExclusive(&draw_statistics_lock);
+	get_draw_statistics(&reset_draw_statistics);
+	ReleaseSRWLockExclusive(&draw_statistics_lock);
+}
+
 
 /*===========
     WINDOW
@@ -1129,6 +2116,145 @@ void gral_window_request_redraw(gral_window *window, int x, int y, int width, in
 	InvalidateRect((HWND)window, &rect, FALSE);
 }
 
+void gral_window_scroll(gral_window *window, int dx, int dy, int x, int y, int width, int height) {
+	HWND hwnd = (HWND)window;
+	WindowData *window_data = (WindowData *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+	if (window_data->target == NULL) {
+		gral_window_request_redraw(window, x, y, width, height);
+		return;
+	}
+	RECT client_rect;
+	GetClientRect(hwnd, &client_rect);
+	RECT rectangle = {x, y, x + width, y + height};
+	if (!IntersectRect(&rectangle, &rectangle, &client_rect)) {
+		return;
+	}
+	// the pixels that stay inside of the rectangle are moved within the retained render target, everything else is exposed
+	RECT destination = rectangle;
+	OffsetRect(&destination, dx, dy);
+	if (!IntersectRect(&destination, &destination, &rectangle)) {
+		InvalidateRect(hwnd, &rectangle, FALSE);
+		return;
+	}
+	ID2D1HwndRenderTarget *target = window_data->target;
+	ComPointer<ID2D1Bitmap> bitmap;
+	if (FAILED(target->CreateBitmap(D2D1::SizeU(destination.right - destination.left, destination.bottom - destination.top), D2D1::BitmapProperties(target->GetPixelFormat()), &bitmap))) {
+		InvalidateRect(hwnd, &rectangle, FALSE);
+		return;
+	}
+	D2D1_POINT_2U origin = D2D1::Point2U(0, 0);
+	D2D1_RECT_U source_rect = D2D1::RectU(destination.left - dx, destination.top - dy, destination.right - dx, destination.bottom - dy);
+	bitmap->CopyFromRenderTarget(&origin, target, &source_rect);
+	target->BeginDraw();
+	target->DrawBitmap(bitmap, D2D1::RectF((FLOAT)destination.left, (FLOAT)destination.top, (FLOAT)destination.right, (FLOAT)destination.bottom), 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+	if (target->EndDraw() == D2DERR_RECREATE_TARGET) {
+		target->Release();
+		window_data->target = NULL;
+		InvalidateRect(hwnd, NULL, FALSE);
+		return;
+	}
+	// damage that has not been painted yet moves along with the pixels
+	HRGN update_region = CreateRectRgn(0, 0, 0, 0);
+	GetUpdateRgn(hwnd, update_region, FALSE);
+	HRGN destination_region = CreateRectRgnIndirect(&destination);
+	HRGN moved_region = CreateRectRgnIndirect(&rectangle);
+	CombineRgn(moved_region, moved_region, update_region, RGN_AND);
+	OffsetRgn(moved_region, dx, dy);
+	CombineRgn(moved_region, moved_region, destination_region, RGN_AND);
+	HRGN exposed_region = CreateRectRgnIndirect(&rectangle);
+	CombineRgn(exposed_region, exposed_region, destination_region, RGN_DIFF);
+	CombineRgn(exposed_region, exposed_region, moved_region, RGN_OR);
+	ValidateRect(hwnd, &destination);
+	InvalidateRgn(hwnd, exposed_region, FALSE);
+	DeleteObject(exposed_region);
+	DeleteObject(moved_region);
+	DeleteObject(destination_region);
+	DeleteObject(update_region);
+}
+
+struct FrameCallbackData {
+	void (*callback)(double presentation_time, double frame_interval, void *user_data);
+	void *user_data;
+	FrameCallbackData *next;
+};
+
+struct FrameEvent {
+	FrameCallbackData *callbacks;
+	double presentation_time;
+	double frame_interval;
+};
+
+static struct {
+	HANDLE thread;
+	SRWLOCK lock;
+	CONDITION_VARIABLE requested;
+	FrameCallbackData *callbacks;
+} frame_clock = {NULL, SRWLOCK_INIT, CONDITION_VARIABLE_INIT, NULL};
+
+static void run_frame_callbacks(void *user_data) {
+	FrameEvent *event = (FrameEvent *)user_data;
+	FrameCallbackData *callbacks = event->callbacks;
+	while (callbacks) {
+		FrameCallbackData *next = callbacks->next;
+		callbacks->callback(event->presentation_time, event->frame_interval, callbacks->user_data);
+		delete callbacks;
+		callbacks = next;
+	}
+	delete event;
+}
+
+static DWORD WINAPI frame_clock_thread(LPVOID lpParameter) {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	for (;;) {
+		AcquireSRWLockExclusive(&frame_clock.lock);
+		while (frame_clock.callbacks == NULL) {
+			SleepConditionVariableSRW(&frame_clock.requested, &frame_clock.lock, INFINITE, 0);
+		}
+		ReleaseSRWLockExclusive(&frame_clock.lock);
+		// DwmFlush returns after the next composition, which happens once per refresh of the display
+		FrameEvent *event = new FrameEvent();
+		DWM_TIMING_INFO timing_info;
+		timing_info.cbSize = sizeof(DWM_TIMING_INFO);
+		if (SUCCEEDED(DwmFlush()) && SUCCEEDED(DwmGetCompositionTimingInfo(NULL, &timing_info)) && timing_info.qpcRefreshPeriod > 0) {
+			event->presentation_time = (double)(timing_info.qpcVBlank + timing_info.qpcRefreshPeriod) / frequency.QuadPart;
+			event->frame_interval = (double)timing_info.qpcRefreshPeriod / frequency.QuadPart;
+		}
+		else {
+			// without desktop composition, fall back to a fixed interval
+			Sleep(16);
+			event->presentation_time = gral_time_get_monotonic();
+			event->frame_interval = 1.0 / 60.0;
+		}
+		// requests made while the callbacks run go into a new list and wait for the next composition
+		AcquireSRWLockExclusive(&frame_clock.lock);
+		event->callbacks = frame_clock.callbacks;
+		frame_clock.callbacks = NULL;
+		ReleaseSRWLockExclusive(&frame_clock.lock);
+		gral_run_on_main_thread(&run_frame_callbacks, event);
+	}
+	return 0;
+}
+
+void gral_window_request_frame(gral_window *window, void (*callback)(double presentation_time, double frame_interval, void *user_data), void *user_data) {
+	FrameCallbackData *callback_data = new FrameCallbackData();
+	callback_data->callback = callback;
+	callback_data->user_data = user_data;
+	callback_data->next = NULL;
+	AcquireSRWLockExclusive(&frame_clock.lock);
+	// keep the callbacks in the order in which they were requested
+	FrameCallbackData **link = &frame_clock.callbacks;
+	while (*link) {
+		link = &(*link)->next;
+	}
+	*link = callback_data;
+	if (frame_clock.thread == NULL) {
+		frame_clock.thread = CreateThread(NULL, 0, &frame_clock_thread, NULL, 0, NULL);
+	}
+	ReleaseSRWLockExclusive(&frame_clock.lock);
+	WakeConditionVariable(&frame_clock.requested);
+}
+
 void gral_window_set_minimum_size(gral_window *window, int minimum_width, int minimum_height) {
 	WindowData *window_data = (WindowData *)GetWindowLongPtr((HWND)window, GWLP_USERDATA);
 	adjust_window_size(minimum_width, minimum_height);
@@ -1136,6 +2262,15 @@ void gral_window_set_minimum_size(gral_window *window, int minimum_width, int mi
 	window_data->minimum_height = minimum_height;
 }
 
+void gral_window_set_redraw_merge_threshold(gral_window *window, int threshold) {
+	WindowData *window_data = (WindowData *)GetWindowLongPtr((HWND)window, GWLP_USERDATA);
+	window_data->redraw_merge_threshold = threshold;
+}
+
+void gral_window_set_render_threads(gral_window *window, int threads) {
+	// Direct2D already rasterizes on the GPU or, with the WARP fallback, on all cores, so there is nothing to distribute
+}
+
 static HCURSOR get_cursor(int cursor) {
 	switch (cursor) {
 	case GRAL_CURSOR_DEFAULT: